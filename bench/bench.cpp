@@ -0,0 +1,137 @@
+#include <QApplication>
+#include <QFile>
+#include <stdio.h>
+
+#include "bench.h"
+
+QByteArray bench_random(qint64 size, uint32_t seed)
+{
+	QByteArray data(size, Qt::Uninitialized);
+
+	//xorshift32
+	char * p = data.data();
+	uint32_t x = seed ? seed : 1;
+	for (qint64 i = 0; i < size; i++) {
+
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		p[i] = x >> 24;
+	}
+
+	return data;
+}
+
+/*
+ * Firmware-like sample: code with repeated instruction patterns, tables
+ * of small numbers, erased flash filled with 0xff and random data.
+ */
+static QByteArray bench_firmware(qint64 size)
+{
+	QByteArray data;
+	data.reserve(size);
+
+	QByteArray noise = bench_random(size, 7);
+	uint32_t x = 3;
+	while (data.size() < size) {
+
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+
+		int n = 64 + (x & 0x3ff);
+		const char * src = noise.constData() + (x >> 8) % (size - n);
+		switch (x & 3) {
+
+			case 0:
+				data.append(noise.mid(data.size() / 2, n));
+				break;
+			case 1:
+				for (int i = 0; i < n; i++)
+					data.append((char)(src[i] & 0x0f));
+				break;
+			case 2:
+				data.append(QByteArray(n, (char)0xff));
+				break;
+			default:
+				data.append(src, n);
+				break;
+		}
+	}
+	data.resize(size);
+
+	return data;
+}
+
+QList <QByteArray> bench_samples(const QStringList & files)
+{
+	QList <QByteArray> samples;
+
+	for (int i = 0; i < files.size(); i++) {
+
+		QFile file(files[i]);
+		if (!file.open(QIODevice::ReadOnly)) {
+			fprintf(stderr, "can't open %s\n", qPrintable(files[i]));
+			continue;
+		}
+		samples.append(file.readAll());
+	}
+
+	if (samples.isEmpty())
+		samples.append(bench_firmware(2*1024*1024));
+
+	return samples;
+}
+
+struct bench_entry_t
+{
+	const char * name;
+	int (* fn)(const QStringList & files);
+};
+
+static const bench_entry_t benches[] =
+{
+	{ "crc", bench_crc },
+	{ "lzss", bench_lzss },
+	{ "header", bench_header },
+	{ "model", bench_model },
+	{ "vbf", bench_vbf },
+	{ "hexview", bench_hexview },
+};
+
+//bench [name] [files...], all benchmarks run without name
+int main(int argc, char *argv[])
+{
+	//hex view is painted into image, no display is needed
+	if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	QApplication a(argc, argv);
+
+	QStringList args = a.arguments();
+	args.removeFirst();
+
+	QString name;
+	if (!args.isEmpty()) {
+
+		for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++)
+			if (args.first() == benches[i].name)
+				name = args.takeFirst();
+	}
+
+	int ret = 0;
+	for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+
+		if (!name.isEmpty() && name != benches[i].name)
+			continue;
+
+		printf("== %s\n", benches[i].name);
+		fflush(stdout);
+		if (benches[i].fn(args)) {
+
+			printf("%s: FAILED\n", benches[i].name);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
@@ -0,0 +1,101 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QStringList>
+
+struct header_t;
+
+//each benchmark is run for at least this long
+#define BENCH_TIME_NS (200*1000*1000LL)
+
+//result of repeated run, runs of fn over bytes each
+struct bench_result_t
+{
+	qint64 runs;
+	qint64 ns;
+	qint64 bytes;
+
+	bench_result_t()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		runs = 0;
+		ns = 0;
+		bytes = 0;
+	}
+
+	double mbs() const
+	{
+		return ns ? (double)bytes * runs * 1000.0 / ns : 0;
+	}
+
+	double us() const
+	{
+		return runs ? (double)ns / runs / 1000.0 : 0;
+	}
+};
+
+//fn is called until BENCH_TIME_NS is spent, at least once
+template <typename F> bench_result_t bench_run(qint64 bytes, F fn)
+{
+	bench_result_t r;
+	r.bytes = bytes;
+
+	QElapsedTimer timer;
+	timer.start();
+	do {
+
+		fn();
+		r.runs++;
+		r.ns = timer.nsecsElapsed();
+	} while (r.ns < BENCH_TIME_NS);
+
+	return r;
+}
+
+//allocations by malloc and friends so far, counted where they can be interposed
+struct bench_alloc_t
+{
+	qint64 count;
+	qint64 bytes;
+
+	bench_alloc_t()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		count = 0;
+		bytes = 0;
+	}
+};
+
+bool bench_alloc_counted();
+bench_alloc_t bench_alloc();
+
+//pseudo random bytes, same for same seed
+QByteArray bench_random(qint64 size, uint32_t seed = 1);
+//files given on command line or firmware-like sample when there are none
+QList <QByteArray> bench_samples(const QStringList & files);
+
+//reference codec of EI 10, EJ 4, P 1 with brute force match search
+QByteArray lzss_ref_encode(const QByteArray & data);
+QByteArray lzss_ref_decode(const QByteArray & cdata);
+//reference header parser with QRegExp, returns size of header or -1
+int header_ref_parse(const QByteArray & h, header_t & header);
+
+//benchmarks return 0 on success, non zero if result is wrong
+int bench_crc(const QStringList & files);
+int bench_lzss(const QStringList & files);
+int bench_header(const QStringList & files);
+int bench_model(const QStringList & files);
+int bench_vbf(const QStringList & files);
+int bench_hexview(const QStringList & files);
+
+#endif
@@ -0,0 +1,13 @@
+QT += concurrent widgets
+
+TARGET = bench
+TEMPLATE = app
+
+CONFIG += console c++11
+CONFIG -= app_bundle
+
+INCLUDEPATH += ..
+
+SOURCES += bench.cpp bench_alloc.cpp bench_crc.cpp bench_lzss.cpp bench_header.cpp bench_model.cpp bench_vbf.cpp bench_hexview.cpp lzss_ref.cpp header_ref.cpp
+SOURCES += ../crc.cpp ../lzss.cpp ../vbffile.cpp ../vbfmodel.cpp ../wdg_hexview.cpp
+HEADERS += bench.h ../crc.h ../lzss.h ../vbffile.h ../vbfmodel.h ../wdg_hexview.h
@@ -0,0 +1,92 @@
+/*
+ * Allocation counter. With glibc, malloc, calloc, realloc and memalign of
+ * the whole process are replaced by counting wrappers around the glibc
+ * ones, so allocations of QByteArray and QVector are seen too.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <QAtomicInteger>
+
+#include "bench.h"
+
+static QAtomicInteger <qint64> alloc_count;
+static QAtomicInteger <qint64> alloc_bytes;
+
+#ifdef __GLIBC__
+
+extern "C" {
+
+void * __libc_malloc(size_t size);
+void * __libc_calloc(size_t n, size_t size);
+void * __libc_realloc(void * p, size_t size);
+void * __libc_memalign(size_t align, size_t size);
+
+static inline void bench_count(size_t size)
+{
+	alloc_count.fetchAndAddRelaxed(1);
+	alloc_bytes.fetchAndAddRelaxed(size);
+}
+
+void * malloc(size_t size)
+{
+	bench_count(size);
+	return __libc_malloc(size);
+}
+
+void * calloc(size_t n, size_t size)
+{
+	bench_count(n * size);
+	return __libc_calloc(n, size);
+}
+
+void * realloc(void * p, size_t size)
+{
+	bench_count(size);
+	return __libc_realloc(p, size);
+}
+
+void * memalign(size_t align, size_t size)
+{
+	bench_count(size);
+	return __libc_memalign(align, size);
+}
+
+void * aligned_alloc(size_t align, size_t size)
+{
+	bench_count(size);
+	return __libc_memalign(align, size);
+}
+
+int posix_memalign(void ** p, size_t align, size_t size)
+{
+	bench_count(size);
+	*p = __libc_memalign(align, size);
+
+	return *p ? 0 : ENOMEM;
+}
+
+}
+
+bool bench_alloc_counted()
+{
+	return true;
+}
+
+#else
+
+bool bench_alloc_counted()
+{
+	return false;
+}
+
+#endif
+
+bench_alloc_t bench_alloc()
+{
+	bench_alloc_t r;
+	r.count = alloc_count.loadAcquire();
+	r.bytes = alloc_bytes.loadAcquire();
+
+	return r;
+}
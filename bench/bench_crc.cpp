@@ -0,0 +1,91 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "crc.h"
+
+//byte at a time, as crc32_calc() of vbffile.cpp was before crc engines
+static uint32_t crc32_ref_table[256];
+
+static void crc32_ref_init()
+{
+	for (int i = 0; i < 256; ++i) {
+
+		uint32_t cr = i;
+		for (int j = 8; j > 0; --j)
+			cr = cr & 0x00000001 ? (cr >> 1) ^ 0xedb88320 : (cr >> 1);
+		crc32_ref_table[i] = cr;
+	}
+}
+
+static uint32_t crc32_ref(const QByteArray & data)
+{
+	uint32_t crc = ~0U;
+	for (int32_t i = 0; i < data.size(); i++)
+		crc = (crc >> 8) ^ crc32_ref_table[(crc ^ (data[i])) & 0xff];
+
+	return ~crc;
+}
+
+//bit at a time, as crc16_calc() of vbffile.cpp was before crc engines
+static uint16_t crc16_ref(const QByteArray & data)
+{
+	uint16_t crc = 0xffff;
+	for (int32_t i = 0; i < data.size(); i++) {
+
+		crc ^= data[i] << 8;
+		for (uint8_t j = 0; j < 8; j++) {
+
+			if (crc & 0x8000)
+				crc = (crc << 1) ^ 0x1021;
+			else
+				crc = crc << 1;
+		}
+		crc &= 0xffff;
+	}
+
+	return crc;
+}
+
+static const int sizes[] = { 64, 4096, 1024*1024, 16*1024*1024 };
+
+//each supported engine against reference, results must be bit identical
+template <typename T> static int bench_engines(const char * name, T (* ref)(const QByteArray &), T (* calc)(const QByteArray &))
+{
+	int ret = 0;
+
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+
+		QByteArray data = bench_random(sizes[s]);
+
+		T expect = 0;
+		bench_result_t r = bench_run(data.size(), [&]() { expect = ref(data); });
+		printf("%s %-8s %9d bytes: %9.1f MB/s\n", name, "ref", data.size(), r.mbs());
+
+		for (int e = e_crc_engine_table; e < e_crc_engine_nums; e++) {
+
+			if (!crc_engine_set((e_crc_engine)e))
+				continue;
+
+			T crc = 0;
+			r = bench_run(data.size(), [&]() { crc = calc(data); });
+			printf("%s %-8s %9d bytes: %9.1f MB/s%s\n", name, crc_engine_name((e_crc_engine)e), data.size(), r.mbs(),
+					crc == expect ? "" : " MISMATCH");
+			if (crc != expect)
+				ret = 1;
+		}
+	}
+
+	crc_engine_set(e_crc_engine_auto);
+
+	return ret;
+}
+
+int bench_crc(const QStringList &)
+{
+	crc32_ref_init();
+
+	int ret = bench_engines <uint32_t> ("crc32", crc32_ref, crc32);
+	ret |= bench_engines <uint16_t> ("crc16", crc16_ref, crc16);
+
+	return ret;
+}
@@ -0,0 +1,89 @@
+#include <stdio.h>
+#include <QFile>
+
+#include "bench.h"
+#include "vbffile.h"
+
+//header as written by save, erase list over several lines
+static QByteArray bench_header_sample()
+{
+	vbf_t vbf;
+	vbf.header.version = "2.4";
+	vbf.header.sw_part_number = "32210987 AB";
+	vbf.header.sw_part_type = "EXE";
+	vbf.header.network = "CAN_HS";
+	vbf.header.can_frame_format = "STANDARD";
+	vbf.header.ecu_address = 0x7e0;
+	vbf.header.data_format_identifier_exist = true;
+	vbf.header.data_format_identifier = 0x10;
+	vbf.header.file_checksum = 0x12345678;
+	for (uint32_t i = 0; i < 8; i++) {
+
+		erase_t erase;
+		erase.addr = 0x80000 + i * 0x20000;
+		erase.size = 0x20000;
+		vbf.header.erases.append(erase);
+	}
+	vbf_update_header(vbf);
+
+	//block directory follows header
+	return vbf.header.data + bench_random(64);
+}
+
+static bool bench_header_equal(const header_t & a, const header_t & b)
+{
+	if (a.erases.size() != b.erases.size())
+		return false;
+	for (int i = 0; i < a.erases.size(); i++)
+		if (a.erases[i].addr != b.erases[i].addr || a.erases[i].size != b.erases[i].size)
+			return false;
+
+	return a.version == b.version && a.sw_part_number == b.sw_part_number && a.sw_part_type == b.sw_part_type &&
+			a.network == b.network && a.can_frame_format == b.can_frame_format && a.frame_format == b.frame_format &&
+			a.ecu_address == b.ecu_address && a.call == b.call && a.file_checksum == b.file_checksum &&
+			a.data_format_identifier_exist == b.data_format_identifier_exist &&
+			a.data_format_identifier == b.data_format_identifier;
+}
+
+/*
+ * Time of one header parse by QRegExp reference and by tokenizer, both
+ * must find the same fields and header size. Headers are read from vbf
+ * files given, else header written by save is used.
+ */
+int bench_header(const QStringList & files)
+{
+	QList <QByteArray> samples;
+	for (int i = 0; i < files.size(); i++) {
+
+		QFile file(files[i]);
+		if (file.open(QIODevice::ReadOnly))
+			samples.append(file.read(HEADER_LIMIT_SIZE));
+		else
+			fprintf(stderr, "can't open %s\n", qPrintable(files[i]));
+	}
+	if (samples.isEmpty())
+		samples.append(bench_header_sample());
+
+	int ret = 0;
+
+	for (int i = 0; i < samples.size(); i++) {
+
+		const QByteArray & h = samples[i];
+
+		header_t ref;
+		int ref_size = 0;
+		bench_result_t r = bench_run(h.size(), [&]() { ref.reset(); ref_size = header_ref_parse(h, ref); });
+		printf("sample %d: header %d bytes\n", i, ref_size);
+		printf("parse  %-9s %9.2f us\n", "ref", r.us());
+
+		header_t header;
+		int size = 0;
+		r = bench_run(h.size(), [&]() { header.reset(); size = vbf_parse_header(h.constData(), h.size(), header); });
+		bool ok = size == ref_size && bench_header_equal(header, ref);
+		printf("parse  %-9s %9.2f us%s\n", "tokenizer", r.us(), ok ? "" : " MISMATCH");
+		if (!ok)
+			ret = 1;
+	}
+
+	return ret;
+}
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <QImage>
+
+#include "bench.h"
+#include "wdg_hexview.h"
+
+//paint taking longer drops below 60 fps
+#define FRAME_TIME_US 16000
+
+/*
+ * Time of one paint of hex view, offscreen into image, at start, middle
+ * and end of huge block. Only visible lines are fetched and drawn, so it
+ * must not depend on size of block and must fit into a 60 fps frame.
+ */
+int bench_hexview(const QStringList &)
+{
+	block_data_t data;
+	QByteArray chunk = bench_random(CHUNK_SIZE);
+	for (int i = 0; i < 256; i++)
+		data.append(chunk);
+
+	wdg_hexview view;
+	view.setAttribute(Qt::WA_DontShowOnScreen);
+	view.resize(1280, 1024);
+	view.show();
+	view.setData(&data);
+
+	QImage image(view.size(), QImage::Format_ARGB32_Premultiplied);
+
+	const char * names[3] = { "start", "middle", "end" };
+	qint64 addrs[3] = { 0, data.size() / 2, data.size() - 1 };
+	int ret = 0;
+
+	printf("block: %lld bytes, view %dx%d\n", data.size(), view.width(), view.height());
+	for (int i = 0; i < 3; i++) {
+
+		view.scrollToAddress(addrs[i]);
+		bench_result_t r = bench_run(0, [&]() { view.render(&image); });
+		bool ok = r.us() < FRAME_TIME_US;
+		printf("frame  %-8s %9.2f us%s\n", names[i], r.us(), ok ? "" : " SLOW");
+		if (!ok)
+			ret = 1;
+	}
+
+	view.setData(NULL);
+
+	return ret;
+}
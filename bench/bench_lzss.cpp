@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <QScopedPointer>
+
+#include "bench.h"
+#include "lzss.h"
+
+/*
+ * Encode speed of brute force reference and of the fast level with hash
+ * chains, both must give the same stream. Decode speed of bit at a time
+ * reference and of word-level decoder, with exact size given or found by
+ * pre-pass, all must give the sample back. Ratio and encode speed of
+ * every level, stream of each must decode to the sample.
+ */
+int bench_lzss(const QStringList & files)
+{
+	QList <QByteArray> samples = bench_samples(files);
+	int ret = 0;
+
+	for (int i = 0; i < samples.size(); i++) {
+
+		const QByteArray & data = samples[i];
+		printf("sample %d: %d bytes\n", i, data.size());
+
+		QByteArray ref;
+		bench_result_t r = bench_run(data.size(), [&]() { ref = lzss_ref_encode(data); });
+		printf("encode %-8s %9d bytes: %9.2f MB/s\n", "ref", ref.size(), r.mbs());
+
+		QScopedPointer <lzss_encoder_t> encoder(lzss_encoder_t::create(e_lzss_10_4_1, e_lzss_level_fast));
+		QByteArray cdata;
+		r = bench_run(data.size(), [&]() { cdata = encoder->encode(data); });
+		printf("encode %-8s %9d bytes: %9.2f MB/s%s\n", lzss_level_name(e_lzss_level_fast), cdata.size(), r.mbs(),
+				cdata == ref ? "" : " MISMATCH");
+		if (cdata != ref)
+			ret = 1;
+
+		QByteArray udata;
+		r = bench_run(data.size(), [&]() { udata = lzss_ref_decode(cdata); });
+		printf("decode %-8s %9d bytes: %9.2f MB/s%s\n", "ref", udata.size(), r.mbs(), udata == data ? "" : " MISMATCH");
+		if (udata != data)
+			ret = 1;
+
+		QScopedPointer <lzss_decoder_t> decoder(lzss_decoder_t::create(e_lzss_10_4_1));
+		r = bench_run(data.size(), [&]() { udata = decoder->decode(cdata, data.size()); });
+		printf("decode %-8s %9d bytes: %9.2f MB/s%s\n", "sized", udata.size(), r.mbs(), udata == data ? "" : " MISMATCH");
+		if (udata != data)
+			ret = 1;
+
+		r = bench_run(data.size(), [&]() { udata = decoder->decode(cdata); });
+		printf("decode %-8s %9d bytes: %9.2f MB/s%s\n", "prepass", udata.size(), r.mbs(), udata == data ? "" : " MISMATCH");
+		if (udata != data)
+			ret = 1;
+
+		for (int l = 0; l < e_lzss_level_nums; l++) {
+
+			QScopedPointer <lzss_encoder_t> level(lzss_encoder_t::create(e_lzss_10_4_1, (e_lzss_level)l));
+			r = bench_run(data.size(), [&]() { cdata = level->encode(data); });
+			udata = decoder->decode(cdata, data.size());
+			printf("level  %-8s %9d bytes: %9.2f MB/s, ratio %.4f%s\n", lzss_level_name((e_lzss_level)l), cdata.size(), r.mbs(),
+					(double)cdata.size() / data.size(), udata == data ? "" : " MISMATCH");
+			if (udata != data)
+				ret = 1;
+		}
+	}
+
+	return ret;
+}
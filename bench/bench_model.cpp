@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <utility>
+
+#include "bench.h"
+#include "vbfmodel.h"
+
+#define MODEL_BLOCKS 16
+#define MODEL_BLOCK_SIZE (4*1024*1024)
+
+//image with edited blocks, their data is in memory only
+static vbf_t bench_model_image()
+{
+	vbf_t vbf;
+	for (int i = 0; i < MODEL_BLOCKS; i++) {
+
+		block_t block;
+		block.addr = 0x80000 + i * MODEL_BLOCK_SIZE;
+		block.data.append(bench_random(MODEL_BLOCK_SIZE, i + 1));
+		block.len = block.data.size();
+		vbf_update_block_crc(block);
+		vbf.blocks.append(block);
+	}
+	vbf_update_checksum(vbf);
+	vbf_update_header(vbf);
+
+	return vbf;
+}
+
+/*
+ * Bytes allocated by moves of image in and out of model, by snapshots for
+ * undo and by header edit. Blocks share their data, so none of these may
+ * allocate anything near size of block data.
+ */
+int bench_model(const QStringList &)
+{
+	if (!bench_alloc_counted()) {
+
+		printf("allocations can't be counted here\n");
+		return 0;
+	}
+
+	vbf_t vbf = bench_model_image();
+	qint64 total = (qint64)MODEL_BLOCKS * MODEL_BLOCK_SIZE;
+	qint64 limit = total / 64;
+	printf("image: %d blocks, %lld bytes, limit %lld bytes per step\n", MODEL_BLOCKS, total, limit);
+
+	VbfModel model;
+	int ret = 0;
+
+	struct step_t
+	{
+		const char * name;
+		bench_alloc_t a;
+	} steps[5];
+	int n = 0;
+
+	bench_alloc_t a = bench_alloc();
+	model.set(std::move(vbf));
+	steps[n].name = "set";
+	steps[n++].a = bench_alloc();
+
+	model.checkpoint();
+	steps[n].name = "snapshot";
+	steps[n++].a = bench_alloc();
+
+	model.update_header("32210987 AB", "EXE", "CAN_HS", "STANDARD", 0x7e0, 0, true);
+	steps[n].name = "header";
+	steps[n++].a = bench_alloc();
+
+	model.undo();
+	steps[n].name = "undo";
+	steps[n++].a = bench_alloc();
+
+	vbf = model.take();
+	steps[n].name = "take";
+	steps[n++].a = bench_alloc();
+
+	//printing allocates, so it is done after all steps
+	for (int i = 0; i < n; i++) {
+
+		qint64 count = steps[i].a.count - a.count;
+		qint64 bytes = steps[i].a.bytes - a.bytes;
+		bool ok = bytes < limit;
+		printf("%-9s %6lld allocations %10lld bytes%s\n", steps[i].name, count, bytes, ok ? "" : " COPIES DATA");
+		if (!ok)
+			ret = 1;
+		a = steps[i].a;
+	}
+
+	if (vbf.blocks.size() != MODEL_BLOCKS)
+		ret = 1;
+
+	return ret;
+}
@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <QTemporaryDir>
+
+#include "bench.h"
+#include "vbffile.h"
+
+#define VBF_BLOCKS 4
+
+//open and save log every block, that is not what is measured
+static void bench_vbf_quiet(QtMsgType, const QMessageLogContext &, const QString &)
+{
+}
+
+//uncompressed image of VBF_BLOCKS blocks written to fileName
+static bool bench_vbf_write(const QString & fileName, qint64 block_size)
+{
+	vbf_t vbf;
+	vbf.header.sw_part_type = "EXE";
+	for (int i = 0; i < VBF_BLOCKS; i++) {
+
+		block_t block;
+		block.addr = 0x80000 + i * block_size;
+		block.data.append(bench_random(block_size, i + 1));
+		block.len = block.data.size();
+		vbf_update_block_crc(block);
+		vbf.blocks.append(block);
+	}
+	vbf_update_checksum(vbf);
+	vbf_update_header(vbf);
+
+	return vbf_save(fileName, vbf);
+}
+
+struct bench_vbf_t
+{
+	bench_result_t r;
+	qint64 count;
+};
+
+template <typename F> static bench_vbf_t bench_vbf_run(qint64 bytes, F fn)
+{
+	bench_vbf_t v;
+	bench_alloc_t a = bench_alloc();
+	v.r = bench_run(bytes, fn);
+	v.count = (bench_alloc().count - a.count) / v.r.runs;
+
+	return v;
+}
+
+/*
+ * Time and allocations of open, which only checksums blocks, and of save
+ * of clean image, which copies them. Both read chunks into scratch buffers
+ * of pool, so allocations must not grow with number of chunks when blocks
+ * get four times larger.
+ */
+int bench_vbf(const QStringList &)
+{
+	QTemporaryDir dir;
+	if (!dir.isValid())
+		return 1;
+
+	QtMessageHandler handler = qInstallMessageHandler(bench_vbf_quiet);
+
+	const char * names[3] = { "open map", "open read", "save" };
+	bench_vbf_t small[3], large[3];
+	qint64 sizes[2] = { 4 * CHUNK_SIZE, 16 * CHUNK_SIZE };
+	bool ok = true;
+
+	for (int s = 0; ok && s < 2; s++) {
+
+		bench_vbf_t * v = s ? large : small;
+		QString src = dir.path() + "/src.vbf";
+		QString dst = dir.path() + "/dst.vbf";
+		qint64 bytes = VBF_BLOCKS * sizes[s];
+		ok = bench_vbf_write(src, sizes[s]);
+
+		for (int m = 0; ok && m < 2; m++) {
+
+			bool mapped = !m;
+			v[m] = bench_vbf_run(bytes, [&]() { vbf_t vbf; ok = ok && vbf_open(src, vbf, mapped); });
+		}
+
+		vbf_t vbf;
+		ok = ok && vbf_open(src, vbf, false);
+		v[2] = bench_vbf_run(bytes, [&]() { ok = ok && vbf_save(dst, vbf); });
+	}
+
+	qInstallMessageHandler(handler);
+
+	if (!ok) {
+
+		printf("can't write, open or save vbf\n");
+		return 1;
+	}
+
+	int ret = 0;
+	qint64 chunks = VBF_BLOCKS * (sizes[1] - sizes[0]) / CHUNK_SIZE;
+	for (int i = 0; i < 3; i++) {
+
+		bool grows = large[i].count - small[i].count >= chunks;
+		printf("%-9s %9.2f MB/s %6lld allocations, %9.2f MB/s %6lld allocations%s\n", names[i],
+				small[i].r.mbs(), small[i].count, large[i].r.mbs(), large[i].count, grows ? " PER CHUNK" : "");
+		if (grows)
+			ret = 1;
+	}
+
+	return ret;
+}
@@ -0,0 +1,136 @@
+/*
+ * Header parser as it was before the tokenizer: brace counting pass, then
+ * line by line split with QRegExp. Debug output of every statement is left
+ * out. Kept as reference for speed and fields of the current parser.
+ */
+
+#include <QBuffer>
+#include <QRegExp>
+
+#include "bench.h"
+#include "vbffile.h"
+
+int header_ref_parse(const QByteArray & h, header_t & header)
+{
+	int offset = h.left(sizeof("vbf_version = 99.99;")).indexOf("vbf_version");
+	if (offset == -1)
+		return -1;
+
+	//looking for such template: header { }
+	offset = h.indexOf("header {");
+	if (offset == -1)
+		return -1;
+	offset += sizeof"header {";
+	size_t left_braces = 1;
+	size_t right_braces = 0;
+	while (offset < h.size()) {
+		if (h[offset] == '}')
+			right_braces++;
+		if (h[offset] == '{')
+			left_braces++;
+		if (left_braces == right_braces)
+			break;
+		offset++;
+	}
+
+	if (left_braces != right_braces)
+		return -1;
+
+	header.file_checksum_offset = h.indexOf("0x", offset + 13);
+	offset = h.indexOf("}", offset);
+
+	offset = h.indexOf("}", offset);
+	if (offset != -1)
+		offset += 1;
+
+	header.data = QByteArray(h.constData(), qBound(0, offset, h.size()));
+
+	//parsing header
+	QBuffer qbuf(&header.data);
+	qbuf.open(QBuffer::ReadOnly);
+
+	QString line;
+	while (!qbuf.atEnd()) {
+
+		QString l = qbuf.readLine();
+
+		if ((-1 != l.indexOf("//")) || (-1 != l.indexOf("header"))) {
+
+			line.clear();
+			continue;
+		}
+
+		line += l;
+
+		//multiline
+		if (-1 == line.indexOf(";"))
+			continue;
+
+		line = line.left(line.indexOf(";"));
+		line.replace("=", " = ");
+
+		QStringList list = line.split(QRegExp("[\r\n\t\",{} ]+"), QString::SkipEmptyParts);
+		line.clear();
+
+		if (list.size() < 3)
+			continue;
+
+		if (list[1] != QString('='))
+			continue;
+
+		if (list[0] == "vbf_version")
+			header.version = list[2];
+
+		if (list[0] == "sw_part_number")
+			header.sw_part_number = list[2];
+
+		if (list[0] == "sw_part_type")
+			header.sw_part_type = list[2];
+
+		if (list[0] == "can_frame_format")
+			header.can_frame_format = list[2];
+
+		//vbf_version 2.2 and above
+		if (list[0] == "frame_format") {
+
+			header.can_frame_format = list[2];
+			header.frame_format = true;
+		}
+
+		if (list[0] == "network")
+			header.network = list[2];
+
+		bool ok;
+		if (list[0] == "erase") {
+
+			list.removeAt(0);
+			list.removeAt(0);
+
+			for (int i = 0; i < list.size()/2; i++) {
+
+				erase_t erase;
+				erase.addr = list[2 * i].toLongLong(&ok, 16);
+				erase.size = list[2 * i + 1].toLongLong(&ok, 16);
+				header.erases.push_back(erase);
+			}
+		}
+
+		if (list[0] == "ecu_address")
+			header.ecu_address = list[2].toLongLong(&ok, 16);
+
+		if (list[0] == "call")
+			header.call = list[2].toLongLong(&ok, 16);
+
+		if (list[0] == "file_checksum")
+			header.file_checksum = list[2].toLongLong(&ok, 16);
+
+		if (list[0] == "data_format_identifier") {
+
+			header.data_format_identifier_exist = true;
+			header.data_format_identifier = list[2].toLongLong(&ok, 16);
+		}
+	}
+	qbuf.close();
+
+	return offset;
+}
@@ -0,0 +1,591 @@
+#include "crc.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CRC_X86 1
+#include <immintrin.h>
+#if defined(__clang__) || (__GNUC__ >= 8)
+#define CRC_X86_VPCLMUL 1
+#endif
+#endif
+
+//CRC-32 normal 0x04c11db7 or reverse 0xedb88320
+static const uint32_t crc32_poly = 0xedb88320;
+static const uint32_t crc32_poly_normal = 0x04c11db7;
+
+//CRC-16/CCITT-FALSE
+static const uint16_t crc16_poly = 0x1021;
+
+//minimal length worth to switch into carry-less multiply folding
+static const size_t crc_fold_min = 256;
+
+struct crc_tables_t
+{
+	//slicing-by-16, crc32_table[0] is classic byte-wise table
+	uint32_t crc32_table[16][256];
+
+	//folding constants, see crc32_fold_const()
+	uint64_t crc32_k128[2];
+	uint64_t crc32_k512[2];
+	uint64_t crc32_k2048[2];
+
+	//slicing-by-16 in normal bit order, crc16_table[0] is byte-wise table
+	uint16_t crc16_table[16][256];
+	uint64_t crc16_k128[2];
+	uint64_t crc16_k512[2];
+
+	//x^(2^n) mod P, reflected, used by crc32_combine()
+	uint32_t crc32_x2n[32];
+
+	e_crc_engine engine;
+
+	crc_tables_t();
+};
+
+static e_crc_engine crc_engine_best();
+static uint32_t crc32_table_calc(uint32_t crc, const uint8_t * p, size_t len);
+static uint32_t crc32_slice16_calc(uint32_t crc, const uint8_t * p, size_t len);
+static uint16_t crc16_slice16_calc(uint16_t crc, const uint8_t * p, size_t len);
+
+//x^n mod P(x), P(x) = x^32 + poly in normal bit order
+static uint32_t xpow_mod32(uint32_t n, uint32_t poly)
+{
+	uint32_t r = 1;
+	while (n--)
+		r = (r & 0x80000000) ? (r << 1) ^ poly : (r << 1);
+
+	return r;
+}
+
+//x^n mod P(x), P(x) = x^16 + poly
+static uint16_t xpow_mod16(uint32_t n, uint16_t poly)
+{
+	uint16_t r = 1;
+	while (n--)
+		r = (r & 0x8000) ? (r << 1) ^ poly : (r << 1);
+
+	return r;
+}
+
+//a * b mod P, both reflected
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b)
+{
+	uint32_t m = 1U << 31;
+	uint32_t p = 0;
+	for (;;) {
+
+		if (a & m) {
+
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ crc32_poly : b >> 1;
+	}
+
+	return p;
+}
+
+static uint64_t reflect64(uint64_t v)
+{
+	uint64_t r = 0;
+	for (int i = 0; i < 64; i++) {
+
+		r = (r << 1) | (v & 1);
+		v >>= 1;
+	}
+
+	return r;
+}
+
+/*
+ * Folding of a 128-bit lane L:H by T bits is done as
+ * L * (x^(T+64) mod P) + H * (x^T mod P), both products fit into 128 bits.
+ * Lanes are bit-reflected, so carry-less product is shifted left by one,
+ * that is compensated by using x^(n-1) in the constants.
+ */
+static void crc32_fold_const(uint64_t k[2], uint32_t bits)
+{
+	k[0] = reflect64(xpow_mod32(bits + 64 - 1, crc32_poly_normal));
+	k[1] = reflect64(xpow_mod32(bits - 1, crc32_poly_normal));
+}
+
+/*
+ * CRC-16 is not reflected, lanes are byte-swapped into normal polynomial
+ * order and products need no correction, H * k[0] ^ L * k[1].
+ */
+static void crc16_fold_const(uint64_t k[2], uint32_t bits)
+{
+	k[0] = xpow_mod16(bits, crc16_poly);
+	k[1] = xpow_mod16(bits + 64, crc16_poly);
+}
+
+crc_tables_t::crc_tables_t()
+{
+	for (int i = 0; i < 256; ++i) {
+
+		uint32_t cr = i;
+		for (int j = 8; j > 0; --j)
+			cr = cr & 0x00000001 ? (cr >> 1) ^ crc32_poly : (cr >> 1);
+		crc32_table[0][i] = cr;
+	}
+
+	for (int i = 0; i < 256; ++i)
+		for (int k = 1; k < 16; k++)
+			crc32_table[k][i] = (crc32_table[k - 1][i] >> 8) ^ crc32_table[0][crc32_table[k - 1][i] & 0xff];
+
+	crc32_fold_const(crc32_k128, 128);
+	crc32_fold_const(crc32_k512, 512);
+	crc32_fold_const(crc32_k2048, 2048);
+
+	uint32_t x2n = 1U << 30;
+	crc32_x2n[0] = x2n;
+	for (int n = 1; n < 32; n++)
+		crc32_x2n[n] = x2n = crc32_multmodp(x2n, x2n);
+
+	for (int i = 0; i < 256; ++i) {
+
+		uint16_t cr = i << 8;
+		for (int j = 8; j > 0; --j)
+			cr = cr & 0x8000 ? (cr << 1) ^ crc16_poly : (cr << 1);
+		crc16_table[0][i] = cr;
+	}
+
+	for (int i = 0; i < 256; ++i)
+		for (int k = 1; k < 16; k++)
+			crc16_table[k][i] = (crc16_table[k - 1][i] << 8) ^ crc16_table[0][crc16_table[k - 1][i] >> 8];
+
+	crc16_fold_const(crc16_k128, 128);
+	crc16_fold_const(crc16_k512, 512);
+
+	engine = crc_engine_best();
+}
+
+static crc_tables_t & tables()
+{
+	static crc_tables_t t;
+
+	return t;
+}
+
+#ifdef CRC_X86
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i crc32_fold128(__m128i x, __m128i k)
+{
+	return _mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00), _mm_clmulepi64_si128(x, k, 0x11));
+}
+
+//CRC-32 of the folded 128-bit remainder followed by the tail
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_fold_finit(__m128i x, const uint8_t * p, size_t len)
+{
+	uint8_t rem[16];
+	_mm_storeu_si128((__m128i *)rem, x);
+
+	uint32_t crc = crc32_slice16_calc(0, rem, sizeof(rem));
+
+	return crc32_slice16_calc(crc, p, len);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_pclmul_calc(uint32_t crc, const uint8_t * p, size_t len)
+{
+	if (len < crc_fold_min)
+		return crc32_slice16_calc(crc, p, len);
+
+	const crc_tables_t & t = tables();
+	const __m128i k128 = _mm_set_epi64x(t.crc32_k128[1], t.crc32_k128[0]);
+	const __m128i k512 = _mm_set_epi64x(t.crc32_k512[1], t.crc32_k512[0]);
+
+	//initial value is xor-ed into first four bytes of message
+	__m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(p + 0x00)), _mm_cvtsi32_si128(crc));
+	__m128i x1 = _mm_loadu_si128((const __m128i *)(p + 0x10));
+	__m128i x2 = _mm_loadu_si128((const __m128i *)(p + 0x20));
+	__m128i x3 = _mm_loadu_si128((const __m128i *)(p + 0x30));
+	p += 64;
+	len -= 64;
+
+	while (len >= 64) {
+
+		x0 = _mm_xor_si128(crc32_fold128(x0, k512), _mm_loadu_si128((const __m128i *)(p + 0x00)));
+		x1 = _mm_xor_si128(crc32_fold128(x1, k512), _mm_loadu_si128((const __m128i *)(p + 0x10)));
+		x2 = _mm_xor_si128(crc32_fold128(x2, k512), _mm_loadu_si128((const __m128i *)(p + 0x20)));
+		x3 = _mm_xor_si128(crc32_fold128(x3, k512), _mm_loadu_si128((const __m128i *)(p + 0x30)));
+		p += 64;
+		len -= 64;
+	}
+
+	x1 = _mm_xor_si128(crc32_fold128(x0, k128), x1);
+	x2 = _mm_xor_si128(crc32_fold128(x1, k128), x2);
+	x3 = _mm_xor_si128(crc32_fold128(x2, k128), x3);
+
+	while (len >= 16) {
+
+		x3 = _mm_xor_si128(crc32_fold128(x3, k128), _mm_loadu_si128((const __m128i *)p));
+		p += 16;
+		len -= 16;
+	}
+
+	return crc32_fold_finit(x3, p, len);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+static inline __m128i crc16_load(const uint8_t * p, __m128i bswap)
+{
+	return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), bswap);
+}
+
+__attribute__((target("pclmul,sse4.1")))
+static uint16_t crc16_pclmul_calc(uint16_t crc, const uint8_t * p, size_t len)
+{
+	if (len < crc_fold_min)
+		return crc16_slice16_calc(crc, p, len);
+
+	const crc_tables_t & t = tables();
+	const __m128i k128 = _mm_set_epi64x(t.crc16_k128[1], t.crc16_k128[0]);
+	const __m128i k512 = _mm_set_epi64x(t.crc16_k512[1], t.crc16_k512[0]);
+	const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+	//initial value is xor-ed into first two bytes of message
+	__m128i x0 = _mm_xor_si128(crc16_load(p + 0x00, bswap), _mm_set_epi64x((uint64_t)crc << 48, 0));
+	__m128i x1 = crc16_load(p + 0x10, bswap);
+	__m128i x2 = crc16_load(p + 0x20, bswap);
+	__m128i x3 = crc16_load(p + 0x30, bswap);
+	p += 64;
+	len -= 64;
+
+	while (len >= 64) {
+
+		x0 = _mm_xor_si128(crc32_fold128(x0, k512), crc16_load(p + 0x00, bswap));
+		x1 = _mm_xor_si128(crc32_fold128(x1, k512), crc16_load(p + 0x10, bswap));
+		x2 = _mm_xor_si128(crc32_fold128(x2, k512), crc16_load(p + 0x20, bswap));
+		x3 = _mm_xor_si128(crc32_fold128(x3, k512), crc16_load(p + 0x30, bswap));
+		p += 64;
+		len -= 64;
+	}
+
+	x1 = _mm_xor_si128(crc32_fold128(x0, k128), x1);
+	x2 = _mm_xor_si128(crc32_fold128(x1, k128), x2);
+	x3 = _mm_xor_si128(crc32_fold128(x2, k128), x3);
+
+	while (len >= 16) {
+
+		x3 = _mm_xor_si128(crc32_fold128(x3, k128), crc16_load(p, bswap));
+		p += 16;
+		len -= 16;
+	}
+
+	uint8_t rem[16];
+	_mm_storeu_si128((__m128i *)rem, _mm_shuffle_epi8(x3, bswap));
+
+	crc = crc16_slice16_calc(0, rem, sizeof(rem));
+
+	return crc16_slice16_calc(crc, p, len);
+}
+
+#ifdef CRC_X86_VPCLMUL
+__attribute__((target("avx512f,vpclmulqdq,pclmul,sse4.1")))
+static inline __m512i crc32_fold512(__m512i x, __m512i k)
+{
+	return _mm512_xor_si512(_mm512_clmulepi64_epi128(x, k, 0x00), _mm512_clmulepi64_epi128(x, k, 0x11));
+}
+
+__attribute__((target("avx512f,vpclmulqdq,pclmul,sse4.1")))
+static uint32_t crc32_vpclmul_calc(uint32_t crc, const uint8_t * p, size_t len)
+{
+	if (len < 4 * crc_fold_min)
+		return crc32_pclmul_calc(crc, p, len);
+
+	const crc_tables_t & t = tables();
+	const __m512i k512 = _mm512_set_epi64(t.crc32_k512[1], t.crc32_k512[0], t.crc32_k512[1], t.crc32_k512[0],
+		t.crc32_k512[1], t.crc32_k512[0], t.crc32_k512[1], t.crc32_k512[0]);
+	const __m512i k2048 = _mm512_set_epi64(t.crc32_k2048[1], t.crc32_k2048[0], t.crc32_k2048[1], t.crc32_k2048[0],
+		t.crc32_k2048[1], t.crc32_k2048[0], t.crc32_k2048[1], t.crc32_k2048[0]);
+	const __m128i k128 = _mm_set_epi64x(t.crc32_k128[1], t.crc32_k128[0]);
+
+	__m512i z0 = _mm512_xor_si512(_mm512_loadu_si512(p + 0x00), _mm512_castsi128_si512(_mm_cvtsi32_si128(crc)));
+	__m512i z1 = _mm512_loadu_si512(p + 0x40);
+	__m512i z2 = _mm512_loadu_si512(p + 0x80);
+	__m512i z3 = _mm512_loadu_si512(p + 0xc0);
+	p += 256;
+	len -= 256;
+
+	while (len >= 256) {
+
+		z0 = _mm512_xor_si512(crc32_fold512(z0, k2048), _mm512_loadu_si512(p + 0x00));
+		z1 = _mm512_xor_si512(crc32_fold512(z1, k2048), _mm512_loadu_si512(p + 0x40));
+		z2 = _mm512_xor_si512(crc32_fold512(z2, k2048), _mm512_loadu_si512(p + 0x80));
+		z3 = _mm512_xor_si512(crc32_fold512(z3, k2048), _mm512_loadu_si512(p + 0xc0));
+		p += 256;
+		len -= 256;
+	}
+
+	z1 = _mm512_xor_si512(crc32_fold512(z0, k512), z1);
+	z2 = _mm512_xor_si512(crc32_fold512(z1, k512), z2);
+	z3 = _mm512_xor_si512(crc32_fold512(z2, k512), z3);
+
+	__m128i lanes[4];
+	_mm512_storeu_si512(lanes, z3);
+
+	__m128i x = lanes[0];
+	x = _mm_xor_si128(crc32_fold128(x, k128), lanes[1]);
+	x = _mm_xor_si128(crc32_fold128(x, k128), lanes[2]);
+	x = _mm_xor_si128(crc32_fold128(x, k128), lanes[3]);
+
+	while (len >= 16) {
+
+		x = _mm_xor_si128(crc32_fold128(x, k128), _mm_loadu_si128((const __m128i *)p));
+		p += 16;
+		len -= 16;
+	}
+
+	return crc32_fold_finit(x, p, len);
+}
+#endif
+#endif
+
+bool crc_engine_supported(e_crc_engine engine)
+{
+	switch (engine) {
+
+		case e_crc_engine_auto:
+		case e_crc_engine_table:
+		case e_crc_engine_slice16:
+			return true;
+#ifdef CRC_X86
+		case e_crc_engine_pclmul:
+			__builtin_cpu_init();
+			return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#ifdef CRC_X86_VPCLMUL
+		case e_crc_engine_vpclmul:
+			__builtin_cpu_init();
+			return crc_engine_supported(e_crc_engine_pclmul) && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("vpclmulqdq");
+#endif
+#endif
+		default:
+			return false;
+	}
+}
+
+static e_crc_engine crc_engine_best()
+{
+	if (crc_engine_supported(e_crc_engine_vpclmul))
+		return e_crc_engine_vpclmul;
+
+	if (crc_engine_supported(e_crc_engine_pclmul))
+		return e_crc_engine_pclmul;
+
+	return e_crc_engine_slice16;
+}
+
+bool crc_engine_set(e_crc_engine engine)
+{
+	crc_tables_t & t = tables();
+
+	if (engine == e_crc_engine_auto)
+		engine = crc_engine_best();
+
+	if (!crc_engine_supported(engine))
+		return false;
+
+	t.engine = engine;
+
+	return true;
+}
+
+e_crc_engine crc_engine()
+{
+	return tables().engine;
+}
+
+const char * crc_engine_name(e_crc_engine engine)
+{
+	switch (engine) {
+
+		case e_crc_engine_auto:
+			return "auto";
+		case e_crc_engine_table:
+			return "table";
+		case e_crc_engine_slice16:
+			return "slice16";
+		case e_crc_engine_pclmul:
+			return "pclmul";
+		case e_crc_engine_vpclmul:
+			return "vpclmul";
+		default:
+			return "unknown";
+	}
+}
+
+uint32_t crc32_init(void)
+{
+	tables();
+
+	return ~0U;
+}
+
+static uint32_t crc32_table_calc(uint32_t crc, const uint8_t * p, size_t len)
+{
+	const uint32_t * table = tables().crc32_table[0];
+
+	while (len--)
+		crc = (crc >> 8) ^ table[(crc ^ *p++) & 0xff];
+
+	return crc;
+}
+
+static inline uint32_t load32le(const uint8_t * p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t crc32_slice16_calc(uint32_t crc, const uint8_t * p, size_t len)
+{
+	const uint32_t (* t)[256] = tables().crc32_table;
+
+	while (len >= 16) {
+
+		uint32_t a = crc ^ load32le(p);
+		uint32_t b = load32le(p + 4);
+		uint32_t c = load32le(p + 8);
+		uint32_t d = load32le(p + 12);
+
+		crc = t[15][a & 0xff] ^ t[14][(a >> 8) & 0xff] ^ t[13][(a >> 16) & 0xff] ^ t[12][a >> 24] ^
+			t[11][b & 0xff] ^ t[10][(b >> 8) & 0xff] ^ t[9][(b >> 16) & 0xff] ^ t[8][b >> 24] ^
+			t[7][c & 0xff] ^ t[6][(c >> 8) & 0xff] ^ t[5][(c >> 16) & 0xff] ^ t[4][c >> 24] ^
+			t[3][d & 0xff] ^ t[2][(d >> 8) & 0xff] ^ t[1][(d >> 16) & 0xff] ^ t[0][d >> 24];
+
+		p += 16;
+		len -= 16;
+	}
+
+	return crc32_table_calc(crc, p, len);
+}
+
+uint32_t crc32_calc(uint32_t crc, const void * data, size_t len)
+{
+	const uint8_t * p = (const uint8_t *)data;
+
+	switch (tables().engine) {
+
+		case e_crc_engine_table:
+			return crc32_table_calc(crc, p, len);
+#ifdef CRC_X86
+		case e_crc_engine_pclmul:
+			return crc32_pclmul_calc(crc, p, len);
+#ifdef CRC_X86_VPCLMUL
+		case e_crc_engine_vpclmul:
+			return crc32_vpclmul_calc(crc, p, len);
+#endif
+#endif
+		default:
+			return crc32_slice16_calc(crc, p, len);
+	}
+}
+
+uint32_t crc32_calc(uint32_t crc, const QByteArray & data)
+{
+	return crc32_calc(crc, data.constData(), data.size());
+}
+
+uint32_t crc32_finit(uint32_t crc)
+{
+	return ~crc;
+}
+
+/*
+ * CRC-32 of A followed by B from crc(A), crc(B) and length of B,
+ * takes O(log(len2)) instead of rescanning A
+ */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+	const uint32_t * x2n = tables().crc32_x2n;
+
+	//x^(8 * len2) mod P
+	uint32_t p = 1U << 31;
+	for (unsigned k = 3; len2; len2 >>= 1, k++)
+		if (len2 & 1)
+			p = crc32_multmodp(x2n[k & 31], p);
+
+	return crc32_multmodp(p, crc1) ^ crc2;
+}
+
+uint32_t crc32(const QByteArray & data)
+{
+	uint32_t crc = crc32_init();
+
+	crc = crc32_calc(crc, data);
+
+	return crc32_finit(crc);
+}
+
+//CRC-16/CCITT-FALSE
+uint16_t crc16_init(void)
+{
+	tables();
+
+	return 0xffff;
+}
+
+static uint16_t crc16_table_calc(uint16_t crc, const uint8_t * p, size_t len)
+{
+	const uint16_t * table = tables().crc16_table[0];
+
+	while (len--)
+		crc = (crc << 8) ^ table[(crc >> 8) ^ *p++];
+
+	return crc;
+}
+
+static uint16_t crc16_slice16_calc(uint16_t crc, const uint8_t * p, size_t len)
+{
+	const uint16_t (* t)[256] = tables().crc16_table;
+
+	while (len >= 16) {
+
+		crc ^= (p[0] << 8) | p[1];
+
+		crc = t[15][crc >> 8] ^ t[14][crc & 0xff] ^ t[13][p[2]] ^ t[12][p[3]] ^
+			t[11][p[4]] ^ t[10][p[5]] ^ t[9][p[6]] ^ t[8][p[7]] ^
+			t[7][p[8]] ^ t[6][p[9]] ^ t[5][p[10]] ^ t[4][p[11]] ^
+			t[3][p[12]] ^ t[2][p[13]] ^ t[1][p[14]] ^ t[0][p[15]];
+
+		p += 16;
+		len -= 16;
+	}
+
+	return crc16_table_calc(crc, p, len);
+}
+
+uint16_t crc16_calc(uint16_t crc, const void * data, size_t len)
+{
+	const uint8_t * p = (const uint8_t *)data;
+
+	switch (tables().engine) {
+
+		case e_crc_engine_table:
+			return crc16_table_calc(crc, p, len);
+#ifdef CRC_X86
+		case e_crc_engine_pclmul:
+		case e_crc_engine_vpclmul:
+			return crc16_pclmul_calc(crc, p, len);
+#endif
+		default:
+			return crc16_slice16_calc(crc, p, len);
+	}
+}
+
+uint16_t crc16_calc(uint16_t crc, const QByteArray & data)
+{
+	return crc16_calc(crc, data.constData(), data.size());
+}
+
+uint16_t crc16(const QByteArray & data)
+{
+	uint16_t crc = crc16_init();
+
+	crc = crc16_calc(crc, data);
+
+	return crc;
+}
+
@@ -0,0 +1,39 @@
+#ifndef CRC_H
+#define CRC_H
+
+#include <QByteArray>
+#include <stddef.h>
+#include <inttypes.h>
+
+enum e_crc_engine
+{
+	e_crc_engine_auto = 0,
+	e_crc_engine_table,
+	e_crc_engine_slice16,
+	e_crc_engine_pclmul,
+	e_crc_engine_vpclmul,
+	e_crc_engine_nums
+};
+
+//select implementation, e_crc_engine_auto picks the fastest supported one
+bool crc_engine_set(e_crc_engine engine);
+bool crc_engine_supported(e_crc_engine engine);
+e_crc_engine crc_engine();
+const char * crc_engine_name(e_crc_engine engine);
+
+//CRC-32 normal 0x04c11db7 or reverse 0xedb88320
+uint32_t crc32_init(void);
+uint32_t crc32_calc(uint32_t crc, const void * data, size_t len);
+uint32_t crc32_calc(uint32_t crc, const QByteArray & data);
+uint32_t crc32_finit(uint32_t crc);
+uint32_t crc32(const QByteArray & data);
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+//CRC-16/CCITT-FALSE
+uint16_t crc16_init(void);
+uint16_t crc16_calc(uint16_t crc, const void * data, size_t len);
+uint16_t crc16_calc(uint16_t crc, const QByteArray & data);
+uint16_t crc16(const QByteArray & data);
+
+#endif
+
@@ -1,249 +1,822 @@
 /* LZSS encoder-decoder (Haruhiko Okumura; public domain) */
 
-#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <QtEndian>
+
 #include "lzss.h"
 
-#define EI 10  /* typically 10..13 */
-#define EJ  4  /* typically 4..5 */
-#define P   1  /* If match length <= P then output one character */
-#define N (1 << EI)  /* buffer size */
-#define F ((1 << EJ) + P)  /* lookahead buffer size */
+#include <QScopedPointer>
+#include <QVector>
+
+#define HASH_SIZE (1 << 16)
+//optimal parse commits this many positions per round and parses ahead
+//of them, so cost of tail does not depend on where round ends
+#define PARSE_SIZE (1 << 15)
+#define PARSE_LOOKAHEAD (1 << 12)
+
+/*
+ * EI  window bits, typically 10..13
+ * EJ  match length bits, typically 4..5
+ * P   if match length <= P then output one character
+ * N   buffer size
+ * F   lookahead buffer size
+ */
+template <int EI, int EJ, int P>
+class lzss_encoder_impl_t : public lzss_encoder_t
+{
+	public:
+		static constexpr int N = 1 << EI;
+		static constexpr int F = (1 << EJ) + 1;
+
+		lzss_encoder_impl_t(e_lzss_level level);
+
+		void start();
+		void push(const QByteArray & data, QByteArray & out);
+		void finish(QByteArray & out);
+
+	private:
+		int find(int p, int f1, int & x);
+		void put_symbol(int x, int y);
+		void step(int f1);
+		void step_lazy(int f1, int f2);
+		void parse(int e, int h);
+		void putbit1();
+		void putbit0();
+		void flush_bit_buffer();
+		void output1(int c);
+		void output2(int x, int y);
+
+		e_lzss_level level;
+		//output of running push() or finish()
+		QByteArray * cdata;
+		int bit_buffer;
+		int bit_mask;
+		QVector <unsigned char> buffer;
+		QVector <int> hash_head;
+		QVector <int> hash_prev;
+		//buffer is shifted once r reaches limit
+		int size;
+		int limit;
+		int prev_mask;
+		int r;
+		int bufferend;
+		int base;
+		int ins;
+
+		//lazy: match already found at next position, absolute
+		int lazy_pos;
+		int lazy_x;
+		int lazy_y;
+
+		//optimal parse: per position match, then chosen length and bit cost
+		QVector <int> match_x;
+		QVector <int> match_y;
+		QVector <int> cost;
+};
+
+//FILL is value of first N - F bytes of window before any output
+template <int EI, int EJ, int FILL>
+class lzss_decoder_impl_t : public lzss_decoder_t
+{
+	public:
+		static constexpr int N = 1 << EI;
+		static constexpr int F = (1 << EJ) + 1;
+
+		lzss_decoder_impl_t();
+
+		qint64 size(const QByteArray & cdata);
+		//every token is longest match in shortest code
+		qint64 size_limit(qint64 csize) const { return csize * 8 / (1 + EI + EJ) * F; }
+		QByteArray decode(const QByteArray & cdata, qint64 size = -1);
+
+		void start();
+		void push(const QByteArray & cdata, QByteArray & out);
+		bool finished() const { return eos; }
+
+	private:
+		void attach(const QByteArray & cdata);
+		void refill();
+		int getbits(int n);
+		int token(qint64 pos, int & c, int & dist);
+
+		const uint8_t * in;
+		const uint8_t * end;
+		uint64_t bits;
+		int nbits;
+		bool eos;
+
+		//streaming state
+		qint64 pos;
+		QVector <unsigned char> window;
+};
+
+template <int EI, int EJ, int P>
+lzss_encoder_impl_t<EI, EJ, P>::lzss_encoder_impl_t(e_lzss_level level) : level(level), bit_buffer(0), bit_mask(128), hash_head(HASH_SIZE)
+{
+	size = N * 2;
+	limit = N * 2 - F;
+	int prev = N;
 
-int bit_buffer = 0, bit_mask = 128;
-unsigned char buffer[N * 2];
+	//chains must also hold positions parsed ahead of r
+	if (level == e_lzss_level_max) {
+
+		limit = N - F + PARSE_SIZE;
+		size = limit + PARSE_LOOKAHEAD;
+		while (prev < N + PARSE_LOOKAHEAD + F)
+			prev <<= 1;
+
+		match_x.resize(size);
+		match_y.resize(size);
+		cost.resize(size + F + 1);
+	}
 
-void putbit1(QByteArray & data)
+	buffer.resize(size);
+	hash_prev.resize(prev);
+	prev_mask = prev - 1;
+
+	start();
+}
+
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::putbit1()
 {
 	bit_buffer |= bit_mask;
 	if ((bit_mask >>= 1) == 0) {
 
-		data.append(bit_buffer);
+		cdata->append(bit_buffer);
 
 		bit_buffer = 0;
 		bit_mask = 128;
 	}
 }
 
-void putbit0(QByteArray & data)
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::putbit0()
 {
 	if ((bit_mask >>= 1) == 0) {
 
-		data.append(bit_buffer);
+		cdata->append(bit_buffer);
 
 		bit_buffer = 0;
 		bit_mask = 128;
 	}
 }
 
-void flush_bit_buffer(QByteArray & data)
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::flush_bit_buffer()
 {
 	if (bit_mask != 128) {
 
-		data.append(bit_buffer);
+		cdata->append(bit_buffer);
 	}
 }
 
-void output1(QByteArray & data, int c)
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::output1(int c)
 {
 	int mask;
 
-	putbit1(data);
+	putbit1();
 	mask = 256;
 	while (mask >>= 1) {
 		if (c & mask)
-			putbit1(data);
+			putbit1();
 		else
-			putbit0(data);
+			putbit0();
 	}
 }
 
-void output2(QByteArray & data, int x, int y)
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::output2(int x, int y)
 {
 	int mask;
 
-	putbit0(data);
+	putbit0();
 	mask = N;
 	while (mask >>= 1) {
 		if (x & mask)
-			putbit1(data);
+			putbit1();
 		else
-			putbit0(data);
+			putbit0();
 	}
 	mask = (1 << EJ);
 	while (mask >>= 1) {
 		if (y & mask)
-			putbit1(data);
+			putbit1();
 		else
-			putbit0(data);
+			putbit0();
 	}
 }
 
-qint32 data_idx = 0;
-
-QByteArray encode(const QByteArray & data)
+/*
+ * Match finder: chains of earlier positions with the same first two bytes,
+ * newest first, positions are absolute (buffer index + shifted bytes).
+ * Walking a chain visits candidates in the same order as scanning the
+ * buffer backwards, so the fast level stream is identical to brute force.
+ */
+static inline int hash_key(const unsigned char * buffer, int i)
 {
-	QByteArray cdata;
-	cdata.reserve(data.size());
+	return (buffer[i] << 8) | buffer[i + 1];
+}
 
-	data_idx = 0;
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::start()
+{
+	cdata = 0;
 	bit_buffer = 0;
 	bit_mask = 128;
 
-	int i, j, f1, x, y, r, s, bufferend, c;
-
-	for (i = 0; i < N - F; i++)
+	unsigned char * buffer = this->buffer.data();
+	for (int i = 0; i < N - F; i++)
 		buffer[i] = '\0';
 
-	for (i = N - F; i < N * 2; i++) {
+	bufferend = N - F;
+	r = N - F;
+
+	this->hash_head.fill(-1);
+
+	base = 0;
+	ins = N - F;
+
+	lazy_pos = -1;
+}
+
+//longest match at p with lookahead f1, 1 if none
+template <int EI, int EJ, int P>
+int lzss_encoder_impl_t<EI, EJ, P>::find(int p, int f1, int & x)
+{
+	unsigned char * buffer = this->buffer.data();
+	int * hash_head = this->hash_head.data();
+	int * hash_prev = this->hash_prev.data();
+
+	int i, j, y;
+
+	x = 0;
+	y = 1;
+
+	if (f1 <= 1)
+		return y;
+
+	for (; ins < p + base; ins++) {
 
-		if (data_idx >= data.size())
+		int key = hash_key(buffer, ins - base);
+		hash_prev[ins & prev_mask] = hash_head[key];
+		hash_head[key] = ins;
+	}
+
+	//match may not reach initial fill and must fit into offset field
+	int lo = (p - (N - F) + 1 > N - F) ? p - (N - F) + 1 : N - F;
+	int pos = hash_head[hash_key(buffer, p)];
+
+	while (pos >= 0) {
+
+		i = pos - base;
+		if (i < lo)
 			break;
 
-		c = data[data_idx++];
-		buffer[i] = c;
+		//optimal parse inserts positions ahead of p, and its longer buffer
+		//holds positions whose offset field would be 0, the end mark
+		if (i < p && ((i - (N - F) + 1) & (N - 1))) {
+
+			for (j = 2; j < f1; j++)
+				if (buffer[i + j] != buffer[p + j])
+					break;
+			if (j > y) {
+				x = i;
+				y = j;
+				if (y == f1)
+					break;
+			}
+		}
+
+		int next = hash_prev[pos & prev_mask];
+		if (next >= pos)
+			break;
+		pos = next;
 	}
-	bufferend = i;
-	r = N - F;
-	s = 0;
 
-	while (r < bufferend) {
+	return y;
+}
+
+//output literal or match at r and move on
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::put_symbol(int x, int y)
+{
+	unsigned char * buffer = this->buffer.data();
 
-		f1 = (F <= bufferend - r) ? F : bufferend - r;
-		x = 0;
+	if (y <= P) {
 		y = 1;
-		c = buffer[r];
+		output1(buffer[r]);
+	}
+	else
+		output2((x - (N - F) + 1) & (N - 1), y - 2);
+
+	r += y;
+
+	//last N - F bytes before r stay as window
+	if (r >= limit) {
+
+		int shift = limit - (N - F);
+		memmove(buffer, buffer + shift, size - shift);
+
+		bufferend -= shift;
+		r -= shift;
+		base += shift;
+	}
+}
+
+//greedy: first longest match at r
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::step(int f1)
+{
+	int x, y;
+
+	y = find(r, f1, x);
+	put_symbol(x, y);
+}
+
+//lazy: literal at r if the match at r + 1 is longer
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::step_lazy(int f1, int f2)
+{
+	int x, y, x2, y2;
+
+	if (lazy_pos == r + base) {
+		x = lazy_x - base;
+		y = lazy_y;
+	}
+	else
+		y = find(r, f1, x);
+
+	lazy_pos = -1;
+
+	//offset of the byte before shift point would read as end mark
+	if (y > P && y < f2 && r + 1 < limit) {
+
+		y2 = find(r + 1, f2, x2);
+		if (y2 > y) {
+
+			lazy_pos = r + 1 + base;
+			lazy_x = x2 + base;
+			lazy_y = y2;
+			y = 1;
+		}
+	}
+
+	put_symbol(x, y);
+}
+
+/*
+ * Optimal parse: cheapest bit cost from each position to h is found
+ * backwards, literal 1 + 8 bits, match 1 + EI + EJ bits. Every match costs
+ * the same, so the longest match at a position stands for all others there,
+ * each shorter length is valid at its offset. Symbols are put from r up to
+ * e only, the rest up to h is parsed again with more data next round.
+ */
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::parse(int e, int h)
+{
+	int * match_x = this->match_x.data();
+	int * match_y = this->match_y.data();
+	int * cost = this->cost.data();
+
+	int p, y;
+
+	for (p = r; p < h; p++)
+		match_y[p] = find(p, (F <= bufferend - p) ? F : bufferend - p, match_x[p]);
 
-		for (i = r - 1; i > s; i--) {
+	for (p = h; p <= h + F; p++)
+		cost[p] = 0;
 
-			if ((s >= (r - i)) && buffer[i] == c) {
+	for (p = h - 1; p >= r; p--) {
 
-				for (j = 1; j < f1; j++)
-					if (buffer[i + j] != buffer[r + j])
-						break;
-				if (j > y) {
-					x = i;
-					y = j;
-				}
+		int best = cost[p + 1] + 9;
+		int len = 1;
+
+		for (y = P + 1; y <= match_y[p]; y++) {
+
+			int c = cost[p + y] + 1 + EI + EJ;
+			if (c <= best) {
+				best = c;
+				len = y;
 			}
 		}
 
-		if (x >= (N - F))
-			x -= (N - F);
-		x++;
+		cost[p] = best;
+		match_y[p] = len;
+	}
 
-		if (y <= P)
-			output1(cdata, c);
-		else
-			output2(cdata, x & (N - 1), y - 2);
+	//put_symbol() shifts buffer only once r reaches limit, e is not past it
+	for (p = r; p < e; p += y) {
 
-		r += y;
-		s += y;
+		y = match_y[p];
+		put_symbol(match_x[p], y);
+	}
+}
 
-		if (r >= N * 2 - F) {
+/*
+ * Symbol is encoded only with full lookahead at hand (whole buffer for
+ * optimal parse), so the stream does not depend on how input is split
+ * into chunks.
+ */
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::push(const QByteArray & data, QByteArray & out)
+{
+	cdata = &out;
 
-			for (i = 0; i < N; i++)
-				buffer[i] = buffer[i + N];
+	unsigned char * buffer = this->buffer.data();
+	const char * in = data.constData();
+	qint32 data_idx = 0;
 
-			bufferend -= N;
-			r -= N;
-			s -= N;
+	while (1) {
 
-			while (bufferend < N * 2) {
+		if (bufferend < size && data_idx < data.size()) {
 
-				if (data_idx >= data.size())
-					break;
+			int n = qMin(size - bufferend, data.size() - data_idx);
+			memcpy(buffer + bufferend, in + data_idx, n);
+			bufferend += n;
+			data_idx += n;
+		}
 
-				c = data[data_idx++];
+		if (level == e_lzss_level_max) {
 
-				buffer[bufferend++] = c;
-			}
+			if (bufferend < size)
+				break;
+			parse(limit, size - F);
+		}
+		else if (level == e_lzss_level_default) {
+
+			if (bufferend - r < F + 1)
+				break;
+			step_lazy(F, F);
+		}
+		else {
+
+			if (bufferend - r < F)
+				break;
+			step(F);
 		}
 	}
 
-	flush_bit_buffer(cdata);
+	cdata = 0;
+}
 
-	return cdata;
+template <int EI, int EJ, int P>
+void lzss_encoder_impl_t<EI, EJ, P>::finish(QByteArray & out)
+{
+	cdata = &out;
+
+	while (r < bufferend) {
+
+		int f1 = (F <= bufferend - r) ? F : bufferend - r;
+
+		if (level == e_lzss_level_max)
+			parse((limit <= bufferend) ? limit : bufferend, bufferend);
+		else if (level == e_lzss_level_default)
+			step_lazy(f1, (F <= bufferend - r - 1) ? F : bufferend - r - 1);
+		else
+			step(f1);
+	}
+
+	flush_bit_buffer();
+	bit_mask = 128;
+
+	cdata = 0;
 }
 
-/* get n bits */
-static int buf, mask = 0;
-int getbit(const QByteArray & data, int n)
+QByteArray lzss_encoder_t::push(const QByteArray & data)
 {
-	int i, x;
+	QByteArray out;
+	push(data, out);
 
-	x = 0;
-	for (i = 0; i < n; i++) {
+	return out;
+}
 
-		if (mask == 0) {
+QByteArray lzss_encoder_t::finish()
+{
+	QByteArray out;
+	finish(out);
+
+	return out;
+}
+
+QByteArray lzss_encoder_t::encode(const QByteArray & data)
+{
+	start();
+
+	QByteArray out;
+	push(data, out);
+	finish(out);
+
+	return out;
+}
+
+template <int EI, int EJ, int FILL>
+lzss_decoder_impl_t<EI, EJ, FILL>::lzss_decoder_impl_t() : in(0), end(0), bits(0), nbits(0), eos(false), pos(0), window(N)
+{
+	start();
+}
+
+template <int EI, int EJ, int FILL>
+void lzss_decoder_impl_t<EI, EJ, FILL>::attach(const QByteArray & cdata)
+{
+	in = (const uint8_t *)cdata.constData();
+	end = in + cdata.size();
+	bits = 0;
+	nbits = 0;
+	eos = false;
+}
+
+/*
+ * Bits are kept MSB aligned in 64-bit buffer. With 8 bytes at hand the
+ * whole word is loaded at once, only complete bytes are accounted and the
+ * extra bits below are the same stream bits loaded next time.
+ */
+template <int EI, int EJ, int FILL>
+inline void lzss_decoder_impl_t<EI, EJ, FILL>::refill()
+{
+	if (end - in >= 8) {
 
-			if (data_idx >= data.size())
-				return EOF;
+		bits |= qFromBigEndian<quint64>(in) >> nbits;
+		in += (63 - nbits) >> 3;
+		nbits |= 56;
+	}
+	else {
 
-			buf = data[data_idx++];
-			mask = 128;
+		while (nbits <= 56 && in < end) {
+
+			bits |= (uint64_t)*in++ << (56 - nbits);
+			nbits += 8;
 		}
-		x <<= 1;
-		if (buf & mask)
-			x++;
-		mask >>= 1;
 	}
+}
+
+/* get n bits */
+template <int EI, int EJ, int FILL>
+inline int lzss_decoder_impl_t<EI, EJ, FILL>::getbits(int n)
+{
+	int x = bits >> (64 - n);
+	bits <<= n;
+	nbits -= n;
 
 	return x;
 }
 
-QByteArray decode(const QByteArray & cdata)
+/*
+ * Parse one token, returns length of output or 0 if there are not enough
+ * bits or end of stream is reached (eos). Incomplete token is not consumed.
+ * Match is returned as distance back from the current output position,
+ * same as window index in ring buffer that starts at output position 0.
+ */
+template <int EI, int EJ, int FILL>
+inline int lzss_decoder_impl_t<EI, EJ, FILL>::token(qint64 pos, int & c, int & dist)
 {
-	data_idx = 0;
+	if (nbits < 1 + EI + EJ)
+		refill();
 
-	QByteArray data;
-	if (cdata.size() < 40 * 1024 * 1024)
-		data.reserve(cdata.size()*6);
-	else
-		data.reserve(cdata.size()*2);
+	if (nbits < 1)
+		return 0;
 
-	int i, j, k, r, c;
+	if (bits >> 63) {
 
-	//prepare global variable
-	mask = 0;
+		if (nbits < 1 + 8)
+			return 0;
 
-	for (i = 0; i < N - F; i++)
-		buffer[i] = ' ';
+		getbits(1);
+		c = getbits(8);
+		dist = 0;
 
-	//r = N - F;
-	r = 0;
-	while ((c = getbit(cdata, 1)) != EOF) {
+		return 1;
+	}
 
-		if (c) {
-			if ((c = getbit(cdata, 8)) == EOF)
-				break;
+	if (nbits < 1 + EI + EJ)
+		return 0;
 
-			//printf("False 0x%x\n", c);
+	getbits(1);
+	int i = getbits(EI);
+	int j = getbits(EJ);
 
-			data.append(c);
-			buffer[r++] = c;
-			r &= (N - 1);
-		} else {
-			if ((i = getbit(cdata, EI)) == EOF)
-				break;
-			if ((j = getbit(cdata, EJ)) == EOF)
-				break;
+	if (i == 0) {
 
-			if (i == 0)
-				break;
+		eos = true;
+		return 0;
+	}
 
-			i -= 1;
+	i -= 1;
+	dist = ((pos - i - 1) & (N - 1)) + 1;
 
-			//printf("True (%u, %u)\n", i, j + 2);
+	return j + 2;
+}
 
-			for (k = 0; k <= j + 1; k++) {
-				c = buffer[(i + k) & (N - 1)];
-				data.append(c);
-				buffer[r++] = c;
-				r &= (N - 1);
-			}
+template <int EI, int EJ, int FILL>
+qint64 lzss_decoder_impl_t<EI, EJ, FILL>::size(const QByteArray & cdata)
+{
+	attach(cdata);
+
+	qint64 pos = 0;
+	int c, dist, len;
+	while ((len = token(pos, c, dist)))
+		pos += len;
+
+	return pos;
+}
+
+template <int EI, int EJ, int FILL>
+QByteArray lzss_decoder_impl_t<EI, EJ, FILL>::decode(const QByteArray & cdata, qint64 size)
+{
+	if (size < 0)
+		size = this->size(cdata);
+
+	if (size > INT_MAX)
+		return QByteArray();
+
+	QByteArray data(size, Qt::Uninitialized);
+	char * out = data.data();
+
+	attach(cdata);
+
+	qint64 pos = 0;
+	int c, dist, len;
+	while ((len = token(pos, c, dist))) {
+
+		if (pos + len > size)
+			break;
+
+		if (!dist) {
+
+			out[pos++] = c;
+			continue;
+		}
+
+		qint64 src = pos - dist;
+		if (src >= 0 && dist >= len) {
+
+			memcpy(out + pos, out + src, len);
+			pos += len;
+		}
+		else if (src >= 0) {
+
+			//overlapped run repeats last dist bytes
+			for (int k = 0; k < len; k++, pos++)
+				out[pos] = out[pos - dist];
+		}
+		else {
+
+			//window before first output byte, N - F of FILL and zeros
+			for (int k = 0; k < len; k++, pos++, src++)
+				out[pos] = (src >= 0) ? out[src] : (((src & (N - 1)) < N - F) ? FILL : '\0');
 		}
 	}
 
+	data.truncate(pos);
+
 	return data;
 }
 
+template <int EI, int EJ, int FILL>
+void lzss_decoder_impl_t<EI, EJ, FILL>::start()
+{
+	attach(QByteArray());
+	pos = 0;
+
+	unsigned char * window = this->window.data();
+	for (int i = 0; i < N; i++)
+		window[i] = (i < N - F) ? FILL : '\0';
+}
+
+/*
+ * Streaming decode keeps last N bytes of output in ring buffer and
+ * unconsumed bits between calls, tokens may span chunk boundary.
+ */
+template <int EI, int EJ, int FILL>
+void lzss_decoder_impl_t<EI, EJ, FILL>::push(const QByteArray & cdata, QByteArray & data)
+{
+	if (eos)
+		return;
+
+	if (data.capacity() < data.size() + cdata.size() * 2)
+		data.reserve(data.size() + cdata.size() * 2);
+
+	in = (const uint8_t *)cdata.constData();
+	end = in + cdata.size();
+
+	unsigned char * window = this->window.data();
+
+	int c, dist, len;
+	while ((len = token(pos, c, dist))) {
+
+		if (!dist) {
+
+			data.append(c);
+			window[pos++ & (N - 1)] = c;
+			continue;
+		}
+
+		for (int k = 0; k < len; k++, pos++) {
+
+			c = window[(pos - dist) & (N - 1)];
+			data.append(c);
+			window[pos & (N - 1)] = c;
+		}
+	}
+
+	//bytes left in chunk are already in bit buffer
+	in = end = 0;
+}
+
+QByteArray lzss_decoder_t::push(const QByteArray & cdata)
+{
+	QByteArray out;
+	push(cdata, out);
+
+	return out;
+}
+
+lzss_encoder_t * lzss_encoder_t::create(e_lzss_variant variant, e_lzss_level level)
+{
+	switch (variant) {
+
+		case e_lzss_11_4_1:
+			return new lzss_encoder_impl_t<11, 4, 1>(level);
+		case e_lzss_12_4_1:
+			return new lzss_encoder_impl_t<12, 4, 1>(level);
+		case e_lzss_12_4_2:
+			return new lzss_encoder_impl_t<12, 4, 2>(level);
+		case e_lzss_13_5_1:
+			return new lzss_encoder_impl_t<13, 5, 1>(level);
+		case e_lzss_10_4_1:
+		case e_lzss_10_4_1_zero:
+		default:
+			return new lzss_encoder_impl_t<10, 4, 1>(level);
+	}
+}
+
+lzss_decoder_t * lzss_decoder_t::create(e_lzss_variant variant)
+{
+	switch (variant) {
+
+		case e_lzss_11_4_1:
+			return new lzss_decoder_impl_t<11, 4, ' '>();
+		case e_lzss_12_4_1:
+		case e_lzss_12_4_2:
+			return new lzss_decoder_impl_t<12, 4, ' '>();
+		case e_lzss_13_5_1:
+			return new lzss_decoder_impl_t<13, 5, ' '>();
+		case e_lzss_10_4_1_zero:
+			return new lzss_decoder_impl_t<10, 4, '\0'>();
+		case e_lzss_10_4_1:
+		default:
+			return new lzss_decoder_impl_t<10, 4, ' '>();
+	}
+}
+
+const char * lzss_variant_name(e_lzss_variant variant)
+{
+	switch (variant) {
+
+		case e_lzss_10_4_1:
+			return "EI 10, EJ 4, P 1";
+		case e_lzss_11_4_1:
+			return "EI 11, EJ 4, P 1";
+		case e_lzss_12_4_1:
+			return "EI 12, EJ 4, P 1";
+		case e_lzss_12_4_2:
+			return "EI 12, EJ 4, P 2";
+		case e_lzss_13_5_1:
+			return "EI 13, EJ 5, P 1";
+		case e_lzss_10_4_1_zero:
+			return "EI 10, EJ 4, P 1, zero fill";
+		default:
+			return "unknown";
+	}
+}
+
+const char * lzss_level_name(e_lzss_level level)
+{
+	switch (level) {
+
+		case e_lzss_level_fast:
+			return "fast";
+		case e_lzss_level_default:
+			return "default";
+		case e_lzss_level_max:
+			return "max";
+		default:
+			return "unknown";
+	}
+}
+
+QByteArray encode(const QByteArray & data, e_lzss_variant variant, e_lzss_level level)
+{
+	QScopedPointer <lzss_encoder_t> encoder(lzss_encoder_t::create(variant, level));
+
+	return encoder->encode(data);
+}
+
+QByteArray decode(const QByteArray & cdata, qint64 size, e_lzss_variant variant)
+{
+	QScopedPointer <lzss_decoder_t> decoder(lzss_decoder_t::create(variant));
+
+	return decoder->decode(cdata, size);
+}
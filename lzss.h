@@ -2,9 +2,77 @@
 #define LZSS_H
 
 #include <QByteArray>
+#include <inttypes.h>
 
-QByteArray encode(const QByteArray &);
-QByteArray decode(const QByteArray &);
+//window bits EI, length bits EJ, longest literal run P and initial window fill
+enum e_lzss_variant
+{
+	e_lzss_10_4_1 = 0,	//vbf data_format_identifier 0x10, window filled with spaces
+	e_lzss_11_4_1,
+	e_lzss_12_4_1,
+	e_lzss_12_4_2,
+	e_lzss_13_5_1,
+	e_lzss_10_4_1_zero,	//window filled with zeros
+	e_lzss_nums
+};
+
+//encoder effort, all levels produce streams for the same decoder
+enum e_lzss_level
+{
+	e_lzss_level_fast = 0,	//greedy, first longest match
+	e_lzss_level_default,	//lazy, literal if next position has longer match
+	e_lzss_level_max,	//optimal parse by bit cost
+	e_lzss_level_nums
+};
+
+//codec state lives in the object, separate objects may run in parallel
+class lzss_encoder_t
+{
+	public:
+		virtual ~lzss_encoder_t() {}
+
+		static lzss_encoder_t * create(e_lzss_variant variant = e_lzss_10_4_1, e_lzss_level level = e_lzss_level_default);
+
+		//whole buffer at once
+		QByteArray encode(const QByteArray & data);
+
+		//streaming: start(), push() chunks of any size, finish(), output is
+		//appended to out, so caller may reuse one buffer for all chunks
+		virtual void start() = 0;
+		virtual void push(const QByteArray & data, QByteArray & out) = 0;
+		virtual void finish(QByteArray & out) = 0;
+		QByteArray push(const QByteArray & data);
+		QByteArray finish();
+};
+
+class lzss_decoder_t
+{
+	public:
+		virtual ~lzss_decoder_t() {}
+
+		static lzss_decoder_t * create(e_lzss_variant variant = e_lzss_10_4_1);
+
+		//exact size of decoded data, cheap pass over the stream
+		virtual qint64 size(const QByteArray & cdata) = 0;
+		//upper bound of decoded size of stream of csize bytes, without reading it
+		virtual qint64 size_limit(qint64 csize) const = 0;
+
+		//decode into buffer of exact size, size is calculated if not known
+		virtual QByteArray decode(const QByteArray & cdata, qint64 size = -1) = 0;
+
+		//streaming: start(), push() chunks of any size, finished() on end mark,
+		//output is appended to out
+		virtual void start() = 0;
+		virtual void push(const QByteArray & cdata, QByteArray & out) = 0;
+		QByteArray push(const QByteArray & cdata);
+		virtual bool finished() const = 0;
+};
+
+const char * lzss_variant_name(e_lzss_variant variant);
+const char * lzss_level_name(e_lzss_level level);
+
+QByteArray encode(const QByteArray &, e_lzss_variant variant = e_lzss_10_4_1, e_lzss_level level = e_lzss_level_default);
+QByteArray decode(const QByteArray &, qint64 size = -1, e_lzss_variant variant = e_lzss_10_4_1);
 
 #endif
 
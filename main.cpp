@@ -54,6 +54,15 @@ main_t::main_t(QWidget *parent) : QMainWindow(parent), m_ui(new Ui::main)
 	connect(m_ui->sb_call, SIGNAL(valueChanged(int)), this, SLOT(slt_header_changed()));
 	connect(m_ui->cb_erase, SIGNAL(stateChanged(int)), this, SLOT(slt_header_changed()));
 
+	for (int i = 0; i < e_lzss_nums; i++)
+		m_ui->cb_lzss_variant->addItem(lzss_variant_name((e_lzss_variant)i));
+	connect(m_ui->cb_lzss_variant, SIGNAL(currentIndexChanged(int)), this, SLOT(slt_lzss_variant_changed(int)));
+
+	//effort is not stored in file, it is used by next save only
+	for (int i = 0; i < e_lzss_level_nums; i++)
+		m_ui->cb_lzss_level->addItem(lzss_level_name((e_lzss_level)i));
+	m_ui->cb_lzss_level->setCurrentIndex(e_lzss_level_default);
+
 	m_ui->view->setModel(&list);
 	m_ui->view->header()->resizeSections(QHeaderView::ResizeToContents);
 	m_ui->view->setSelectionMode(QAbstractItemView::SingleSelection);
@@ -71,17 +80,45 @@ main_t::main_t(QWidget *parent) : QMainWindow(parent), m_ui(new Ui::main)
 	connect(m_ui->btn_import, &QToolButton::clicked, this, &main_t::slt_btn_import);
 	connect(m_ui->btn_add, &QToolButton::clicked, this, &main_t::slt_btn_add);
 
+	m_ui->btn_undo->setIcon(QIcon::fromTheme("edit-undo"));
+	m_ui->btn_undo->setShortcut(QKeySequence::Undo);
+	m_ui->btn_redo->setIcon(QIcon::fromTheme("edit-redo"));
+	m_ui->btn_redo->setShortcut(QKeySequence::Redo);
+	connect(m_ui->btn_undo, &QToolButton::clicked, this, &main_t::slt_btn_undo);
+	connect(m_ui->btn_redo, &QToolButton::clicked, this, &main_t::slt_btn_redo);
+	connect(&list, &VbfModel::sig_history, this, &main_t::slt_history);
+	slt_history();
+
 	connect(m_ui->btn_block_open, &QToolButton::clicked, this, &main_t::slt_btn_block_open);
 	connect(m_ui->btn_block_save, &QToolButton::clicked, this, &main_t::slt_btn_block_save);
 	connect(m_ui->sb_block_addr, SIGNAL(valueChanged(double)), this, SLOT(slt_block_changed()));
 
 	connect(m_ui->btn_about, &QToolButton::clicked, this, &main_t::slt_btn_about);
 
+	connect(this, &main_t::sig_log, this, &main_t::slt_log);
+
+	//open, save, import and export run in background
+	progress = new QProgressBar(this);
+	progress->setRange(0, 100);
+	progress->setMaximumWidth(200);
+	progress->hide();
+	m_ui->statusBar->addPermanentWidget(progress);
+
+	btn_cancel = new QToolButton(this);
+	btn_cancel->setText(tr("Cancel"));
+	btn_cancel->hide();
+	m_ui->statusBar->addPermanentWidget(btn_cancel);
+	connect(btn_cancel, &QToolButton::clicked, this, &main_t::slt_btn_cancel);
+
+	connect(&job, &VbfJob::sig_progress, this, &main_t::slt_job_progress);
+	connect(&job, &VbfJob::sig_finished, this, &main_t::slt_job_finished);
+
 	m_ui->stack->setCurrentIndex(e_page_main);
 }
 
 main_t::~main_t()
 {
+	main_t::ptr = NULL;
 	delete m_ui;
 }
 
@@ -104,26 +141,10 @@ void main_t::slt_btn_open()
 	QString fileName;
 	fileName = QFileDialog::getOpenFileName(this, tr("Open vbf file"), "./", tr("vbf (*.vbf *.VBF)"));
 
-	vbf_t vbf;
-	bool ret = vbf_open(fileName, vbf);
-	if (!ret) {
-
-		m_ui->statusBar->showMessage(tr("Open %1 failed").arg(fileName));
+	if (fileName.isEmpty())
 		return;
-	}
-
-	list.set(vbf);
-	m_ui->stack->setCurrentIndex(e_page_main);
-
-	load_header();
-
-	QCoreApplication::processEvents();
-	m_ui->view->header()->resizeSections(QHeaderView::ResizeToContents);
-	m_ui->view->expandAll();
-
-	setWindowTitle(fileName);
 
-	m_ui->statusBar->showMessage(tr("Open %1").arg(fileName));
+	open_file_vbf(fileName);
 }
 
 void main_t::slt_btn_save()
@@ -134,11 +155,122 @@ void main_t::slt_btn_save()
 	if (fileName.isEmpty())
 		return;
 
-	const vbf_t & vbf = list.get();
+	//model is read in place, it is locked while job is running
+	job.set_level((e_lzss_level)m_ui->cb_lzss_level->currentIndex());
+	start_job(job.start(VbfJob::e_job_save, fileName, &list.get()));
+}
+
+void main_t::start_job(bool started)
+{
+	if (!started) {
+
+		m_ui->statusBar->showMessage(tr("Busy"));
+		return;
+	}
+
+	set_busy(true);
+}
+
+//everything but log and cancel is locked while job is running
+void main_t::set_busy(bool busy)
+{
+	m_ui->btn_open->setEnabled(!busy);
+	m_ui->btn_save->setEnabled(!busy);
+	m_ui->btn_export->setEnabled(!busy);
+	m_ui->btn_import->setEnabled(!busy);
+	m_ui->btn_add->setEnabled(!busy);
+	m_ui->view->setEnabled(!busy);
+	m_ui->stack->setEnabled(!busy);
+
+	progress->setValue(0);
+	progress->setVisible(busy);
+	btn_cancel->setVisible(busy);
+
+	slt_history();
+}
 
-	vbf_save(fileName, vbf);
+void main_t::slt_btn_cancel()
+{
+	job.cancel();
+}
+
+void main_t::slt_job_progress(int percent, int block_idx)
+{
+	progress->setValue(percent);
+	progress->setFormat(tr("block %1: %p%").arg(block_idx));
+}
+
+void main_t::slt_job_finished(bool ok)
+{
+	set_busy(false);
+
+	const QString & fileName = job.file_name();
+
+	switch (job.job()) {
+
+		case VbfJob::e_job_open:
+			if (!ok) {
+
+				//partial image holds source file open and mapped
+				job.take();
+				m_ui->statusBar->showMessage(tr("Open %1 failed").arg(fileName));
+				return;
+			}
+
+			//whole result replaces model at once
+			m_ui->hexview->setData(NULL);
+			list.set(job.take());
+			m_ui->stack->setCurrentIndex(e_page_main);
+
+			load_header();
+
+			QCoreApplication::processEvents();
+			m_ui->view->header()->resizeSections(QHeaderView::ResizeToContents);
+			m_ui->view->expandAll();
+
+			setWindowTitle(fileName);
+
+			m_ui->statusBar->showMessage(tr("Open %1").arg(fileName));
+			break;
+
+		case VbfJob::e_job_save:
+			if (ok)
+				m_ui->statusBar->showMessage(tr("Saved %1").arg(fileName));
+			else
+				m_ui->statusBar->showMessage(tr("Save %1 failed").arg(fileName));
+			break;
+
+		case VbfJob::e_job_import:
+			//image goes back also when import is cancelled, blocks done so far are updated
+			list.set(job.take(), true);
+			list.update_checksum();
+			m_ui->stack->setCurrentIndex(e_page_main);
+
+			m_ui->statusBar->showMessage(ok ? tr("Import files") : tr("Import files failed"));
+
+			slt_header_changed();
+			break;
+
+		case VbfJob::e_job_export:
+			//blocks were not edited while job was running
+			list.update_bin(job.bins());
+			m_ui->statusBar->showMessage(ok ? tr("Export files") : tr("Export files failed"));
+			break;
+
+		case VbfJob::e_job_load:
+			if (!ok || !list.set_loaded(job.block_idx(), job.block())) {
+
+				m_ui->statusBar->showMessage(tr("Load block %1 failed").arg(job.block_idx() + 1));
+				return;
+			}
+
+			//selection is locked while job is running
+			show_block(job.block_idx() + 1);
+			break;
 
-	m_ui->statusBar->showMessage(tr("Saved %1").arg(fileName));
+		default:
+			break;
+	}
 }
 
 void main_t::slt_btn_add()
@@ -172,20 +304,61 @@ void main_t::slt_btn_add()
 
 void main_t::slt_btn_import()
 {
-	m_ui->statusBar->showMessage(tr("Import files"));
-
-	vbf_t vbf = list.get();
-	vbf_import(vbf);
-	list.set(vbf);
+	if (job.busy())
+		return;
 
-	slt_header_changed();
+	//image is moved to job and back, view must not refer to its blocks meanwhile
+	m_ui->hexview->setData(NULL);
+	list.checkpoint();
+	start_job(job.start(VbfJob::e_job_import, QString(), list.take()));
 }
 
 void main_t::slt_btn_export()
 {
-	const vbf_t & vbf = list.get();
-	vbf_export(vbf);
-	m_ui->statusBar->showMessage(tr("Export files"));
+	start_job(job.start(VbfJob::e_job_export, QString(), &list.get()));
+}
+
+void main_t::slt_btn_undo()
+{
+	if (job.busy() || !list.can_undo())
+		return;
+
+	m_ui->hexview->setData(NULL);
+	list.undo();
+	reload_view();
+
+	m_ui->statusBar->showMessage(tr("Undo"));
+}
+
+void main_t::slt_btn_redo()
+{
+	if (job.busy() || !list.can_redo())
+		return;
+
+	m_ui->hexview->setData(NULL);
+	list.redo();
+	reload_view();
+
+	m_ui->statusBar->showMessage(tr("Redo"));
+}
+
+//image was replaced, widgets show it again
+void main_t::reload_view()
+{
+	m_ui->stack->setCurrentIndex(e_page_main);
+	load_header();
+
+	QCoreApplication::processEvents();
+	m_ui->view->header()->resizeSections(QHeaderView::ResizeToContents);
+	m_ui->view->expandAll();
+}
+
+void main_t::slt_history()
+{
+	bool busy = job.busy();
+
+	m_ui->btn_undo->setEnabled(!busy && list.can_undo());
+	m_ui->btn_redo->setEnabled(!busy && list.can_redo());
 }
 
 void main_t::slt_view_clicked(const QModelIndex & idx)
@@ -217,13 +390,10 @@ void main_t::slt_btn_block_open()
 	QString fileName;
 	fileName = QFileDialog::getOpenFileName(this, tr("Open bin file"), fn, tr("bin (*.bin *.BIN)"));
 
-	QFile file(fileName);
-	if (!file.open(QIODevice::ReadOnly))
+	block_data_t data;
+	if (!vbf_read_file(fileName, data))
 		return;
 
-	QByteArray data = file.readAll();
-	file.close();
-
 	list.update_block(idx - 1, data);
 	const block_t & block = list.get_block(idx - 1);
 	m_ui->hexview->setData(&block.data);
@@ -270,15 +440,7 @@ void main_t::slt_btn_block_save()
 
 void main_t::open_file_vbf(const QString & fileName)
 {
-	vbf_t vbf;
-	if (vbf_open(fileName, vbf))
-		list.set(vbf);
-
-	load_header();
-
-	QCoreApplication::processEvents();
-	m_ui->view->header()->resizeSections(QHeaderView::ResizeToContents);
-	m_ui->view->expandAll();
+	start_job(job.start(VbfJob::e_job_open, fileName));
 }
 
 void main_t::load_header()
@@ -292,6 +454,7 @@ void main_t::load_header()
 	m_ui->sb_ecu_address->blockSignals(true);
 	m_ui->sb_call->blockSignals(true);
 	m_ui->cb_erase->blockSignals(true);
+	m_ui->cb_lzss_variant->blockSignals(true);
 
 	m_ui->le_part_number->setText(vbf.header.sw_part_number);
 	m_ui->cb_part_type->setCurrentText(vbf.header.sw_part_type);
@@ -301,6 +464,8 @@ void main_t::load_header()
 	m_ui->sb_call->setValue(vbf.header.call);
 	m_ui->sb_call->setEnabled((vbf.header.sw_part_type == "SBL") ? true : false);
 	m_ui->cb_erase->setChecked(vbf.header.erases.size() ? true : false);
+	m_ui->cb_lzss_variant->setCurrentIndex(vbf.header.lzss_variant);
+	m_ui->cb_lzss_variant->setEnabled(vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10);
 
 	m_ui->le_part_number->blockSignals(false);
 	m_ui->cb_part_type->blockSignals(false);
@@ -309,6 +474,7 @@ void main_t::load_header()
 	m_ui->sb_ecu_address->blockSignals(false);
 	m_ui->sb_call->blockSignals(false);
 	m_ui->cb_erase->blockSignals(false);
+	m_ui->cb_lzss_variant->blockSignals(false);
 
 	m_ui->text->clear();
 	m_ui->text->insertPlainText(vbf.header.data);
@@ -334,72 +500,77 @@ void main_t::slt_selection_changed(const QItemSelection &)
 	}
 	else if (idx <= list.size()) {
 
-		m_ui->sb_block_addr->blockSignals(true);
-		const block_t & block = list.get_block(idx - 1);
-		m_ui->sb_block_addr->setValue(block.addr);
-
-		const vbf_t & vbf = list.get();
-		QString slen;
-		if (vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10)
-			slen = QString("%1(%2)").arg(block.len).arg(block.data.size());
-		else
-			slen = QString("%1").arg(block.len);
-
-		m_ui->lbl_block_size->setStyleSheet("QLabel {}");
-		if (block.len > BLOCK_LIMIT_SIZE) {
-			slen += " only first 1GB";
-			m_ui->lbl_block_size->setStyleSheet("QLabel { background-color : red }");
-		}
-		m_ui->lbl_block_size->setText(slen);
-
-		m_ui->hexview->setData(&block.data);
-		m_ui->sb_block_addr->blockSignals(false);
+		//data is read on thread pool, block is shown when job is finished
+		if (!list.get_block(idx - 1).loaded) {
 
-		m_ui->statusBar->showMessage(tr("Load block %1").arg(idx));
+			m_ui->hexview->setData(NULL);
+			start_job(job.start(VbfJob::e_job_load, idx - 1, &list.get()));
+			m_ui->statusBar->showMessage(tr("Loading block %1").arg(idx));
+			return;
+		}
 
-		m_ui->stack->setCurrentIndex(e_page_block);
+		show_block(idx);
 	}
 }
 
-void main_t::slt_header_changed()
+void main_t::show_block(int idx)
 {
-	const vbf_t & vbf = list.get();
+	m_ui->sb_block_addr->blockSignals(true);
+	const block_t & block = list.get_block(idx - 1);
+	m_ui->sb_block_addr->setValue(block.addr);
 
-	header_t header = vbf.header;
-	header.sw_part_number = m_ui->le_part_number->text();
-	header.sw_part_type = m_ui->cb_part_type->currentText();
-	header.network = m_ui->cb_network->currentText();
-	header.can_frame_format = m_ui->cb_can_frame_format->currentText();
-	header.ecu_address = m_ui->sb_ecu_address->value();
-	header.call = m_ui->sb_call->value();
+	const vbf_t & vbf = list.get();
+	QString slen;
+	if (vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10)
+		slen = QString("%1(%2)").arg(block.len).arg(block.data.size());
+	else
+		slen = QString("%1").arg(block.len);
 
-	if (!m_ui->cb_erase->isChecked())
-		header.erases.clear();
+	//edited data over 4GB can't be stored uncompressed
+	m_ui->lbl_block_size->setStyleSheet("QLabel {}");
+	if (block.len > BLOCK_STORED_LIMIT) {
+		slen += " too large for vbf";
+		m_ui->lbl_block_size->setStyleSheet("QLabel { background-color : red }");
+	}
+	m_ui->lbl_block_size->setText(slen);
 
-	if (m_ui->cb_erase->isChecked() && !header.erases.size()) {
+	m_ui->hexview->setData(&block.data);
+	m_ui->sb_block_addr->blockSignals(false);
 
-		for (int32_t i = 0; i < vbf.blocks.size(); i++) {
+	m_ui->statusBar->showMessage(tr("Load block %1").arg(idx));
 
-			const block_t & block = vbf.blocks[i];
+	m_ui->stack->setCurrentIndex(e_page_block);
+}
 
-			erase_t erase;
-			erase.addr = block.addr;
-			erase.size = block.len;
-			header.erases.push_back(erase);
-		}
-	}
+void main_t::slt_header_changed()
+{
+	QString sw_part_type = m_ui->cb_part_type->currentText();
 
-	m_ui->sb_call->setEnabled((header.sw_part_type == "SBL") ? true : false);
+	m_ui->sb_call->setEnabled((sw_part_type == "SBL") ? true : false);
 
-	list.update_header(header);
-	const vbf_t & new_vbf = list.get();
+	list.update_header(m_ui->le_part_number->text(), sw_part_type, m_ui->cb_network->currentText(),
+			m_ui->cb_can_frame_format->currentText(), m_ui->sb_ecu_address->value(), m_ui->sb_call->value(),
+			m_ui->cb_erase->isChecked());
+	const vbf_t & vbf = list.get();
 
 	m_ui->text->clear();
-	m_ui->text->insertPlainText(new_vbf.header.data);
+	m_ui->text->insertPlainText(vbf.header.data);
 
 	m_ui->statusBar->showMessage(tr("Update header"));
 }
 
+//blocks are decoded again with selected variant
+void main_t::slt_lzss_variant_changed(int idx)
+{
+	if (idx < 0 || idx >= e_lzss_nums)
+		return;
+
+	m_ui->hexview->setData(NULL);
+	list.update_lzss_variant((e_lzss_variant)idx);
+
+	m_ui->statusBar->showMessage(tr("Update lzss %1").arg(lzss_variant_name((e_lzss_variant)idx)));
+}
+
 void main_t::slt_block_changed()
 {
 	int idx = get_selected_row();
@@ -449,10 +620,9 @@ void main_t::QDebugMessageHandler(QtMsgType type, const QMessageLogContext &cont
 			break;
 	}
 
-	if (main_t::ptr) {
-		main_t::ptr->main_t::slt_log(lvl, qPrintable(message));
-		QCoreApplication::processEvents();
-	}
+	//queued to gui thread when logged from worker
+	if (main_t::ptr)
+		emit main_t::ptr->sig_log(lvl, message);
 }
 
 int main(int argc, char *argv[])
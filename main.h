@@ -3,8 +3,11 @@
 
 #include <QMainWindow>
 #include <QItemSelection>
+#include <QProgressBar>
+#include <QToolButton>
 
 #include "vbfmodel.h"
+#include "vbfjob.h"
 
 enum e_log_level
 {
@@ -33,9 +36,17 @@ class main_t : public QMainWindow
 		static void QDebugMessageHandler(QtMsgType type, const QMessageLogContext &context, const QString &msg);
 		static main_t * ptr;
 
+	signals:
+		//messages may come from worker threads
+		void sig_log(uint8_t lvl, const QString & txt);
+
 	private:
 		int get_selected_row();
 		void load_header();
+		void show_block(int idx);
+		void start_job(bool started);
+		void set_busy(bool busy);
+		void reload_view();
 
 	private slots:
 		void slt_btn_open();
@@ -43,18 +54,28 @@ class main_t : public QMainWindow
 		void slt_btn_export();
 		void slt_btn_import();
 		void slt_btn_add();
+		void slt_btn_undo();
+		void slt_btn_redo();
+		void slt_history();
 		void slt_view_clicked(const QModelIndex & idx);
 		void slt_selection_changed(const QItemSelection & selection);
 		void slt_btn_block_open();
 		void slt_btn_block_save();
 		void slt_header_changed();
+		void slt_lzss_variant_changed(int idx);
 		void slt_block_changed();
 		void slt_btn_about(int);
+		void slt_btn_cancel();
+		void slt_job_progress(int percent, int block_idx);
+		void slt_job_finished(bool ok);
 
 	private:
 		Ui::main *m_ui;
+		QProgressBar * progress;
+		QToolButton * btn_cancel;
 
 		VbfModel list;
+		VbfJob job;
 };
 
 #endif
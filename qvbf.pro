@@ -1,14 +1,16 @@
-QT += widgets
+QT += widgets concurrent
 
 TARGET = qvbf
 TEMPLATE = app
 
-SOURCES += main.cpp vbffile.cpp vbfmodel.cpp wdg_hexview.cpp lzss.cpp
-HEADERS += main.h vbffile.h vbfmodel.h wdg_hexview.h spinbox.h lzss.h
+SOURCES += main.cpp vbffile.cpp vbfmodel.cpp vbfjob.cpp wdg_hexview.cpp lzss.cpp crc.cpp
+HEADERS += main.h vbffile.h vbfmodel.h vbfjob.h wdg_hexview.h spinbox.h lzss.h crc.h
 FORMS += main.ui
 
 RESOURCES += qvbf.qrc
 
+CONFIG += c++11
+
 CONFIG += static
 
 static {
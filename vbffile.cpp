@@ -1,556 +1,1603 @@
+#include <string.h>
+#include <stdlib.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
 #include <QtEndian>
-#include <QBuffer>
-#include <QCoreApplication>
 #include <QDebug>
+#include <QFuture>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QtConcurrentRun>
+
+#include "vbffile.h"
+#include "lzss.h"
+#include "crc.h"
+
+#if QT_VERSION < 0x050700
+template <typename T> inline T qFromUnaligned(const void *src)
+{
+    T dest;
+    const size_t size = sizeof(T);
+    memcpy(&dest, src, size);
+    return dest;
+}
+
+
+template <class T> inline T qFromBigEndian(const void *src)
+{
+    return qFromBigEndian(qFromUnaligned<T>(src));
+}
+#endif
+
+void block_data_t::append(const QByteArray & data)
+{
+	//whole extent is shared, not copied
+	if (data.size() <= CHUNK_SIZE && (extents.isEmpty() || extents.last().size() == CHUNK_SIZE)) {
+
+		if (data.size())
+			extents.append(data);
+		len += data.size();
+		return;
+	}
+
+	append(data.constData(), data.size());
+}
+
+void block_data_t::append(const char * data, qint64 n)
+{
+	qint64 done = 0;
+	while (done < n) {
+
+		if (extents.isEmpty() || extents.last().size() == CHUNK_SIZE) {
+
+			//extent is allocated once with its final size
+			extents.append(QByteArray());
+			extents.last().reserve(CHUNK_SIZE);
+		}
+
+		QByteArray & e = extents.last();
+		int sz = qMin<qint64>(CHUNK_SIZE - e.size(), n - done);
+		e.append(data + done, sz);
+		done += sz;
+	}
+	len += n;
+}
+
+qint64 block_data_t::read(qint64 pos, char * data, qint64 n) const
+{
+	if (pos < 0 || pos >= len || n <= 0)
+		return 0;
+
+	n = qMin(n, len - pos);
+
+	qint64 done = 0;
+	for (int i = pos / CHUNK_SIZE; done < n && i < extents.size(); i++) {
+
+		const QByteArray & e = extents[i];
+		int from = (pos + done) % CHUNK_SIZE;
+		int sz = qMin<qint64>(e.size() - from, n - done);
+		memcpy(data + done, e.constData() + from, sz);
+		done += sz;
+	}
+
+	return done;
+}
+
+QByteArray block_data_t::mid(qint64 pos, qint64 n) const
+{
+	if (pos < 0 || pos >= len || n <= 0)
+		return QByteArray();
+
+	QByteArray r(qMin(n, len - pos), Qt::Uninitialized);
+	r.resize(read(pos, r.data(), r.size()));
+
+	return r;
+}
+
+qint64 vbf_map_t::read(qint64 pos, char * buf, qint64 n)
+{
+	if (pos < 0 || pos >= size || n <= 0)
+		return 0;
+
+	n = qMin(n, size - pos);
+
+	if (data) {
+
+		memcpy(buf, data + pos, n);
+		return n;
+	}
+
+	QMutexLocker locker(&lock);
+
+	if (!file.seek(pos))
+		return -1;
+
+	return file.read(buf, n);
+}
+
+qint64 vbf_map_t::locate(qint64 offset) const
+{
+	if (!replaced)
+		return offset;
+
+	return moved.value(offset, -1);
+}
+
+static uint16_t vbf_crc16(const block_data_t & data)
+{
+	uint16_t crc = crc16_init();
+	for (int i = 0; i < data.extents.size(); i++)
+		crc = crc16_calc(crc, data.extents[i]);
+
+	return crc;
+}
+
+static uint32_t vbf_crc32(const block_data_t & data)
+{
+	uint32_t crc = crc32_init();
+	for (int i = 0; i < data.extents.size(); i++)
+		crc = crc32_calc(crc, data.extents[i]);
+
+	return crc32_finit(crc);
+}
+
+bool vbf_read_file(const QString & fileName, block_data_t & data)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	data.reset();
+	while (1) {
+
+		QByteArray chunk = file.read(CHUNK_SIZE);
+		if (chunk.isEmpty())
+			break;
+		data.append(chunk);
+	}
+
+	bool ok = data.size() == file.size();
+	file.close();
+
+	return ok;
+}
+
+//huge page, slabs of pool are aligned to it
+#define POOL_SLAB_SIZE (2*1024*1024)
+
+//posix_memalign is missing on MinGW
+static void * vbf_slab_alloc()
+{
+#ifdef Q_OS_WIN
+	return _aligned_malloc(POOL_SLAB_SIZE, POOL_SLAB_SIZE);
+#else
+	void * slab = 0;
+	if (posix_memalign(&slab, POOL_SLAB_SIZE, POOL_SLAB_SIZE))
+		return 0;
+	return slab;
+#endif
+}
+
+static void vbf_slab_free(void * slab)
+{
+#ifdef Q_OS_WIN
+	_aligned_free(slab);
+#else
+	::free(slab);
+#endif
+}
+
+/*
+ * CHUNK_SIZE scratch buffers of one operation, shared by its jobs. They are
+ * recycled instead of allocated for every chunk read and go away with pool.
+ */
+struct vbf_pool_t
+{
+	QMutex lock;
+	QVector <char *> slabs;
+	QVector <char *> free;
+
+	~vbf_pool_t()
+	{
+		for (int i = 0; i < slabs.size(); i++)
+			vbf_slab_free(slabs[i]);
+	}
+
+	char * take()
+	{
+		QMutexLocker locker(&lock);
+
+		if (free.isEmpty()) {
+
+			void * slab = vbf_slab_alloc();
+			Q_CHECK_PTR(slab);
+#ifdef MADV_HUGEPAGE
+			madvise(slab, POOL_SLAB_SIZE, MADV_HUGEPAGE);
+#endif
+			slabs.append((char *)slab);
+			for (int i = 0; i < POOL_SLAB_SIZE / CHUNK_SIZE; i++)
+				free.append((char *)slab + i * CHUNK_SIZE);
+		}
+
+		return free.takeLast();
+	}
+
+	void give(char * buf)
+	{
+		QMutexLocker locker(&lock);
+
+		free.append(buf);
+	}
+};
+
+struct block_load_t
+{
+	block_t block;
+	//crc16 over data and crc32 over bytes as stored in file
+	uint16_t crc;
+	uint32_t raw_crc32;
+	qint64 raw_size;
+};
+
+/*
+ * Runs on worker thread, reads from mapping or file handle of source.
+ * Without decode only checksums of bytes as stored in file are taken.
+ */
+static block_load_t vbf_read_block(const block_t & entry, bool compress, e_lzss_variant variant, bool decode, vbf_pool_t * pool,
+		vbf_progress_t * progress)
+{
+	vbf_pool_t own;
+	if (!pool)
+		pool = &own;
+
+	block_load_t load;
+	load.block = entry;
+	load.crc = crc16_init();
+	load.raw_crc32 = crc32_init();
+	load.raw_size = 0;
+
+	block_t & block = load.block;
+	vbf_map_t * map = block.map.data();
+	qint64 offset = map ? map->locate(block.offset) : -1;
+
+	if (offset < 0) {
+
+		if (map)
+			qWarning().nospace() << "Data of block addr: 0x" << hex << block.addr << " is not in source file anymore";
+		load.raw_crc32 = crc32_finit(load.raw_crc32);
+		return load;
+	}
+
+	//compressed data is piped through decoder chunk by chunk into one reused buffer
+	QScopedPointer <lzss_decoder_t> decoder(lzss_decoder_t::create(variant));
+	uint16_t crc = crc16_init();
+	QByteArray udata;
+	if (decode && compress)
+		udata.reserve(CHUNK_SIZE * 2);
+
+	//read chunk not kept as extent goes to scratch buffer
+	char * scratch = (map->data || (decode && !compress)) ? 0 : pool->take();
+
+	qint64 left = block.len;
+	while (left > 0) {
+
+		if (progress) {
+
+			progress->percent.store((int)(load.raw_size * 100 / block.len));
+			if (progress->cancel.load())
+				break;
+		}
+
+		QByteArray chunk;
+		const char * data;
+		qint64 sz;
+		qint64 pos = offset + load.raw_size;
+		if (map->data) {
+
+			sz = qMin<qint64>(qMin<qint64>(left, CHUNK_SIZE), map->size - pos);
+			data = map->data + pos;
+		}
+		else if (scratch) {
+
+			sz = map->read(pos, scratch, qMin<qint64>(left, CHUNK_SIZE));
+			data = scratch;
+		}
+		else {
+
+			chunk.resize(qMin<qint64>(left, CHUNK_SIZE));
+			sz = map->read(pos, chunk.data(), chunk.size());
+			chunk.resize((sz > 0) ? sz : 0);
+			data = chunk.constData();
+		}
+		if (sz <= 0)
+			break;
+		left -= sz;
+
+		load.crc = crc16_calc(load.crc, data, sz);
+		load.raw_crc32 = crc32_calc(load.raw_crc32, data, sz);
+		load.raw_size += sz;
+		if (!decode)
+			continue;
+
+		//raw data header of QByteArray is allocated, so chunk is wrapped only for decode
+		if (chunk.isEmpty())
+			chunk = QByteArray::fromRawData(data, sz);
+
+		//chunks of CHUNK_SIZE become extents as they are, slices of mapping are not copied
+		if (compress) {
+
+			udata.resize(0);
+			decoder->push(chunk, udata);
+			crc = crc16_calc(crc, udata);
+			block.data.append(udata.constData(), udata.size());
+		}
+		else
+			block.data.append(chunk);
+	}
+	load.raw_crc32 = crc32_finit(load.raw_crc32);
+
+	if (left > 0 && !(progress && progress->cancel.load()))
+		qWarning().nospace() << "Can't read block addr: 0x" << hex << block.addr << " at offset 0x" << offset + load.raw_size;
+
+	if (scratch)
+		pool->give(scratch);
+
+	if (!decode)
+		return load;
+
+	if (compress)
+		load.crc = crc;
+	else {
+
+		block.crc = load.crc;
+		block.data_crc32 = load.raw_crc32;
+		block.crc_valid = true;
+	}
+	block.loaded = true;
+
+	return load;
+}
+
+bool vbf_load_block(const vbf_t & vbf, block_t & block, vbf_progress_t * progress)
+{
+	if (block.loaded)
+		return true;
+
+	bool compress = vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10;
+
+	block_load_t load = vbf_read_block(block, compress, vbf.header.lzss_variant, true, 0, progress);
+	if (!load.block.loaded || load.raw_size != block.len) {
+
+		qWarning().nospace() << "Can't load block addr: 0x" << hex << block.addr;
+		return false;
+	}
+
+	if (compress)
+		qDebug() << "uncompress block data: " << block.len << " to "<< load.block.data.size();
+
+	//source changed since open or wrong lzss variant, bad data is not shown as block
+	if (load.crc != block.payload_crc) {
+
+		qWarning() << "mismatch crc16:" << hex << load.crc << "block crc:" << hex << block.payload_crc;
+		return false;
+	}
+
+	block = load.block;
+
+	return true;
+}
+
+void vbf_unload_block(block_t & block)
+{
+	//edited data has no copy in file
+	if (!block.loaded || block.dirty || !block.map)
+		return;
+
+	block.data.reset();
+	block.loaded = false;
+}
+
+//header token, text points into header bytes
+enum e_vbf_token
+{
+	e_vbf_token_end = 0,
+	e_vbf_token_word,	//name, number or other bare value
+	e_vbf_token_string,	//text between quotes
+	e_vbf_token_char	//one of = ; , { }
+};
+
+struct vbf_token_t
+{
+	e_vbf_token type;
+	const char * text;
+	int len;
+};
+
+static inline bool vbf_is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline bool vbf_is_char(char c)
+{
+	return c == '=' || c == ';' || c == ',' || c == '{' || c == '}';
+}
+
+static inline bool vbf_is_comment(const char * p, const char * end)
+{
+	return p[0] == '/' && p + 1 < end && (p[1] == '/' || p[1] == '*');
+}
+
+//next token from p, whitespace and // or /* */ comments are skipped
+static void vbf_next_token(const char * & p, const char * end, vbf_token_t & tok)
+{
+	while (p < end) {
+
+		if (vbf_is_space(*p))
+			p++;
+		else if (vbf_is_comment(p, end) && p[1] == '/') {
+
+			while (p < end && *p != '\n')
+				p++;
+		}
+		else if (vbf_is_comment(p, end)) {
+
+			for (p += 2; p < end; p++)
+				if (p[0] == '*' && p + 1 < end && p[1] == '/')
+					break;
+			p = (p < end) ? p + 2 : end;
+		}
+		else
+			break;
+	}
+
+	tok.text = p;
+	tok.len = 0;
+
+	if (p >= end) {
+
+		tok.type = e_vbf_token_end;
+		return;
+	}
+
+	if (vbf_is_char(*p)) {
+
+		tok.type = e_vbf_token_char;
+		tok.len = 1;
+		p++;
+		return;
+	}
+
+	if (*p == '"') {
+
+		tok.type = e_vbf_token_string;
+		tok.text = ++p;
+		while (p < end && *p != '"')
+			p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+		tok.len = ((p < end) ? p : end) - tok.text;
+		if (p < end)
+			p++;
+		return;
+	}
+
+	tok.type = e_vbf_token_word;
+	while (p < end && !vbf_is_space(*p) && !vbf_is_char(*p) && *p != '"' && !vbf_is_comment(p, end))
+		p++;
+	tok.len = p - tok.text;
+}
+
+static inline bool vbf_token_is(const vbf_token_t & tok, const char * word)
+{
+	int len = strlen(word);
+
+	return tok.type == e_vbf_token_word && tok.len == len && !memcmp(tok.text, word, len);
+}
+
+static inline bool vbf_token_is(const vbf_token_t & tok, char c)
+{
+	return tok.type == e_vbf_token_char && *tok.text == c;
+}
+
+static inline QString vbf_token_string(const vbf_token_t & tok)
+{
+	return QString::fromLatin1(tok.text, tok.len);
+}
+
+//hex number with or without 0x, 0 if it is not a number
+static uint32_t vbf_token_hex(const vbf_token_t & tok)
+{
+	const char * p = tok.text;
+	const char * end = tok.text + tok.len;
+
+	if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+		p += 2;
+	if (p == end)
+		return 0;
+
+	uint32_t v = 0;
+	for (; p < end; p++) {
+
+		int d;
+		if (*p >= '0' && *p <= '9')
+			d = *p - '0';
+		else if (*p >= 'a' && *p <= 'f')
+			d = *p - 'a' + 10;
+		else if (*p >= 'A' && *p <= 'F')
+			d = *p - 'A' + 10;
+		else
+			return 0;
+		v = (v << 4) | d;
+	}
+
+	return v;
+}
+
+/*
+ * Rest of statement after its key: = value ;
+ * Value is word, string or list in nested braces, list is flattened,
+ * key takes its first value, erase takes pairs of values.
+ */
+static bool vbf_parse_statement(const char * data, const char * & p, const char * end, const vbf_token_t & key, header_t & header)
+{
+	vbf_token_t tok;
+
+	vbf_next_token(p, end, tok);
+	if (!vbf_token_is(tok, '='))
+		return false;
+
+	int depth = 0;
+	int nums = 0;
+	erase_t erase;
+
+	while (1) {
+
+		vbf_next_token(p, end, tok);
+
+		if (tok.type == e_vbf_token_end)
+			return false;
+
+		if (tok.type == e_vbf_token_char) {
+
+			if (vbf_token_is(tok, '{'))
+				depth++;
+			else if (vbf_token_is(tok, '}')) {
+
+				if (!depth)
+					return false;
+				depth--;
+			}
+			else if (vbf_token_is(tok, ';'))
+				return !depth;
+			else if (vbf_token_is(tok, '='))
+				return false;
+
+			continue;
+		}
+
+		if (vbf_token_is(key, "erase")) {
+
+			if (nums & 1) {
+
+				erase.size = vbf_token_hex(tok);
+				header.erases.push_back(erase);
+			}
+			else
+				erase.addr = vbf_token_hex(tok);
+		}
+
+		if (nums++)
+			continue;
+
+		if (vbf_token_is(key, "vbf_version"))
+			header.version = vbf_token_string(tok);
+		else if (vbf_token_is(key, "sw_part_number"))
+			header.sw_part_number = vbf_token_string(tok);
+		else if (vbf_token_is(key, "sw_part_type"))
+			header.sw_part_type = vbf_token_string(tok);
+		else if (vbf_token_is(key, "can_frame_format"))
+			header.can_frame_format = vbf_token_string(tok);
+		//vbf_version 2.2 and above
+		else if (vbf_token_is(key, "frame_format")) {
+
+			header.can_frame_format = vbf_token_string(tok);
+			header.frame_format = true;
+		}
+		else if (vbf_token_is(key, "network"))
+			header.network = vbf_token_string(tok);
+		else if (vbf_token_is(key, "ecu_address"))
+			header.ecu_address = vbf_token_hex(tok);
+		else if (vbf_token_is(key, "call"))
+			header.call = vbf_token_hex(tok);
+		else if (vbf_token_is(key, "file_checksum")) {
+
+			header.file_checksum = vbf_token_hex(tok);
+			header.file_checksum_offset = tok.text - data;
+		}
+		else if (vbf_token_is(key, "data_format_identifier")) {
+
+			header.data_format_identifier_exist = true;
+			header.data_format_identifier = vbf_token_hex(tok);
+		}
+	}
+}
+
+/*
+ * Single pass over header bytes without copies:
+ * vbf_version = x; header { key = value; ... }
+ * Returns size of header up to its closing brace or -1.
+ */
+int vbf_parse_header(const char * data, int size, header_t & header)
+{
+	const char * p = data;
+	const char * end = data + size;
+	vbf_token_t tok;
+
+	vbf_next_token(p, end, tok);
+	if (!vbf_token_is(tok, "vbf_version") || !vbf_parse_statement(data, p, end, tok, header)) {
+		qWarning() << "can't find header 'vbf_version' in file";
+		return -1;
+	}
+
+	vbf_next_token(p, end, tok);
+	if (!vbf_token_is(tok, "header")) {
+		qWarning() << "can't find begin of header";
+		return -1;
+	}
+
+	vbf_next_token(p, end, tok);
+	if (!vbf_token_is(tok, '{')) {
+		qWarning() << "can't find begin of header";
+		return -1;
+	}
+
+	while (1) {
+
+		vbf_next_token(p, end, tok);
+
+		if (vbf_token_is(tok, '}'))
+			return p - data;
+
+		if (tok.type != e_vbf_token_word) {
+			qWarning() << "can't find end of header";
+			return -1;
+		}
+
+		if (!vbf_parse_statement(data, p, end, tok, header)) {
+			qWarning().nospace() << "can't parse header at offset 0x" << hex << (tok.text - data);
+			return -1;
+		}
+	}
+}
+
+//report block idx and done steps out of nums, false if operation is cancelled
+static bool vbf_progress(vbf_progress_t * progress, int32_t idx, int64_t done, int64_t nums)
+{
+	if (!progress)
+		return true;
+
+	progress->block_idx.store(idx);
+	progress->percent.store(nums ? (int)(done * 100 / nums) : 100);
+
+	return !progress->cancel.load();
+}
+
+bool vbf_open(const QString & fileName, vbf_t & vbf, bool mapped, vbf_progress_t * progress)
+{
+	qInfo() << "Opening file " << fileName << " ... ";
+
+	//blocks refer to source file, read from mapping when possible
+	QSharedPointer <vbf_map_t> map(new vbf_map_t);
+	map->file.setFileName(fileName);
+	map->data = 0;
+	map->size = 0;
+	if (!map->file.open(QIODevice::ReadOnly)) {
+		qWarning() << "Can't open file " << fileName;
+		return false;
+	}
+	map->size = map->file.size();
+	qDebug() << "file size:" << map->size;
+	qDebug() << "crc engine:" << crc_engine_name(crc_engine());
+
+#ifdef Q_OS_WIN
+	//mapped file can't be replaced by save over it, while loaded blocks
+	//are slices of mapping it can't be released either
+	mapped = false;
+#endif
+	if (mapped)
+		map->data = (const char *)map->file.map(0, map->size);
+	if (map->data)
+		qDebug() << "file is mapped";
+	else if (mapped)
+		qDebug() << "can't map file, reading it";
+
+	QByteArray h;
+	if (map->data)
+		h = QByteArray::fromRawData(map->data, qMin<qint64>(map->size, HEADER_LIMIT_SIZE));
+	else {
+
+		h.resize(qMin<qint64>(map->size, HEADER_LIMIT_SIZE));
+		qint64 sz = map->read(0, h.data(), h.size());
+		h.resize((sz > 0) ? sz : 0);
+	}
+
+	header_t header;
+	int offset = vbf_parse_header(h.constData(), h.size(), header);
+	if (offset < 0)
+		return false;
+
+	//own copy, h may point into mapping
+	header.data = QByteArray(h.constData(), offset);
+	qDebug() << "header:" << header.data;
+
+	vbf.filename = fileName;
+	vbf.header = header;
+	vbf.size = 0;
+
+	bool compress = vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10;
+	if (compress)
+		qDebug() << "lzss:" << lzss_variant_name(header.lzss_variant);
+
+	//scan block directory, data is loaded on demand
+	QVector <block_t> entries;
+	qint64 pos = offset;
+	while (1) {
+
+		block_t block;
+
+		char head[8];
+		if (8 != map->read(pos, head, 8))
+			break;
+		block.addr = qFromBigEndian<quint32>(head);
+		block.len = qFromBigEndian<quint32>(head + 4);
+		block.offset = pos + 8;
+		block.map = map;
+		block.loaded = false;
+		block.dirty = false;
+
+		qDebug().nospace() << "found block addr:0x" << hex << block.addr << " with size:0x" << hex << block.len;
+
+		char _crc[2];
+		if (2 != map->read(block.offset + block.len, _crc, 2))
+			break;
+		block.payload_crc = qFromBigEndian<quint16>(_crc);
+
+		entries.push_back(block);
+		pos = block.offset + block.len + 2;
+	}
+
+	//only checksums of stored bytes on open, jobs share scratch buffers
+	vbf_pool_t pool;
+	QVector <QFuture <block_load_t> > jobs;
+	e_lzss_variant variant = header.lzss_variant;
+	for (int32_t i = 0; i < entries.size(); i++) {
+
+		//QtConcurrent::run of Qt5 passes five arguments at most
+		const block_t & entry = entries[i];
+		jobs.push_back(QtConcurrent::run([=, &pool]() { return vbf_read_block(entry, compress, variant, false, &pool, 0); }));
+	}
+
+	//collect blocks in file order
+	uint32_t crc32 = crc32_init();
+	for (int32_t i = 0; i < entries.size(); i++) {
+
+		if (!vbf_progress(progress, i, i, entries.size())) {
+
+			qWarning() << "Open is cancelled";
+
+			//running jobs use pool
+			for (int32_t j = i; j < entries.size(); j++)
+				jobs[j].waitForFinished();
+			return false;
+		}
+
+		block_load_t load = jobs[i].result();
+		jobs[i] = QFuture <block_load_t>();
+
+		block_t & block = load.block;
+		block.payload_crc32 = load.raw_crc32;
+
+		uint32_t head[2] = { qToBigEndian<quint32>(block.addr), qToBigEndian<quint32>(block.len) };
+		crc32 = crc32_calc(crc32, head, sizeof(head));
+		//file crc is running over raw block bytes
+		crc32 = crc32_finit(crc32_combine(crc32_finit(crc32), load.raw_crc32, load.raw_size));
+
+		uint16_t _crc16 = block.payload_crc;
+		uint16_t _crc = qToBigEndian<quint16>(_crc16);
+		crc32 = crc32_calc(crc32, &_crc, sizeof(_crc));
+
+		//crc16 of compressed block is over decoded data, it is checked on load
+		qDebug().nospace() << "block addr: 0x" << hex << block.addr << " len: 0x" << block.len << " _crc16: 0x" << _crc16;
+		if (load.raw_size != block.len)
+			qWarning() << "block is truncated";
+		else if (!compress && _crc16 != load.crc)
+			qWarning() << "mismatch crc16:" << hex << load.crc << "block crc:" << hex << _crc16;
+		else {
+
+			vbf.blocks.push_back(block);
+			vbf.size += block.len;
+		}
+	}
+
+	crc32 = crc32_finit(crc32);
+	vbf_progress(progress, entries.size(), entries.size(), entries.size());
+
+	if (crc32 != header.file_checksum) {
+
+		qWarning() << "mismatch crc32:" << hex << crc32 << "header crc:" << hex << header.file_checksum;
+		return false;
+	}
+	qInfo() << "crc32 is OK";
+
+	qInfo() << "vbf with " << vbf.blocks.size() << " block(s) successfully loaded";
+
+	return true;
+}
+
+bool vbf_add(const QString & fileName, vbf_t & vbf)
+{
+	block_t block;
+	block.addr = 0;
+	if (!vbf_read_file(fileName, block.data))
+		return false;
+	block.len = block.data.size();
+
+	vbf.blocks.push_back(block);
+
+	return true;
+}
+
+bool vbf_insert(int idx, const QString & fileName, vbf_t & vbf)
+{
+	if (idx > vbf.blocks.size())
+		return false;
+
+	block_t block;
+	block.addr = 0;
+	if (!vbf_read_file(fileName, block.data))
+		return false;
+	block.len = block.data.size();
+
+	vbf.blocks.insert(idx, block);
+
+	return true;
+}
+
+/*
+ * Copy range of source file to dst without passing data through user
+ * space: copy_file_range, then sendfile, then mapping or locked read of
+ * map for what is left or where neither is available. Handle opened with
+ * map is used with explicit offsets, so file replaced by name since open
+ * is not read and position of shared handle is left alone.
+ */
+static bool vbf_copy_range(vbf_map_t * map, qint64 offset, qint64 len, QFile & dst)
+{
+	if (offset + len > map->size)
+		return false;
+
+	if (!dst.flush())
+		return false;
+	qint64 start = dst.pos();
+	qint64 left = len;
+
+#ifdef __linux__
+	int in = map->file.handle();
+	int out = dst.handle();
+
+#ifdef SYS_copy_file_range
+	loff_t off_in = offset;
+	loff_t off_out = start;
+	while (left > 0) {
+
+		ssize_t n = syscall(SYS_copy_file_range, in, &off_in, out, &off_out, (size_t)qMin<qint64>(left, 0x40000000), 0);
+		if (n <= 0)
+			break;
+		left -= n;
+	}
+#endif
 
-#include "vbffile.h"
-#include "lzss.h"
+	//sendfile writes at current position of out
+	if (left > 0 && lseek(out, start + len - left, SEEK_SET) >= 0) {
 
-//CRC-32 normal 0x04c11db7 or reverse 0xedb88320
-static const uint32_t crc32_poly = 0xedb88320;
-static uint32_t crc32_table[256];
-static uint32_t crc32_init(void)
-{
-	for (int i = 0; i < 256; ++i) {
+		off_t off = offset + len - left;
+		while (left > 0) {
 
-		uint32_t cr = i;
-		for (int j = 8; j > 0; --j)
-			cr = cr & 0x00000001 ? (cr >> 1) ^ crc32_poly : (cr >> 1);
-		crc32_table[i] = cr;
+			ssize_t n = sendfile(out, in, &off, (size_t)qMin<qint64>(left, 0x40000000));
+			if (n <= 0)
+				break;
+			left -= n;
+		}
 	}
+#endif
 
-	return ~0U;
-}
+	if (!dst.seek(start + len - left))
+		return false;
 
-static uint32_t crc32_calc(uint32_t crc, const QByteArray & data)
-{
-	for (int32_t i = 0; i < data.size(); i++)
-		crc = (crc >> 8) ^ crc32_table[( crc ^ (data[i]) ) & 0xff];
+	QByteArray buf;
+	if (left > 0 && !map->data)
+		buf.resize(CHUNK_SIZE);
 
-	return crc;
-}
+	while (left > 0) {
 
-static uint32_t crc32_finit(uint32_t crc)
-{
-	return ~crc;
+		qint64 pos = offset + len - left;
+		qint64 sz = qMin<qint64>(left, CHUNK_SIZE);
+		const char * chunk = map->data ? map->data + pos : buf.constData();
+		if (!map->data)
+			sz = map->read(pos, buf.data(), sz);
+		if (sz <= 0 || dst.write(chunk, sz) != sz)
+			return false;
+		left -= sz;
+	}
+
+	return dst.seek(start + len);
 }
 
-static uint32_t crc32(const QByteArray & data)
+//write data of block to bin file, stamp is filled on success
+static bool vbf_export_bin(int idx, const QString & fileName, const vbf_t & vbf, bin_stamp_t & bin)
 {
-	uint32_t crc = crc32_init();
+	if (idx < 0 || idx >= vbf.blocks.size())
+		return false;
 
-	crc = crc32_calc(crc, data);
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
 
-	return crc32_finit(crc);
-}
+	const block_t & block = vbf.blocks[idx];
+	bool compress = vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10;
+	bool ok;
 
-//CRC-16/CCITT-FALSE
-static const uint16_t crc16_poly = 0x1021;
-static uint16_t crc16_init(void)
-{
-	return 0xffff;
-}
+	//stored bytes of untouched uncompressed block are its data, they are
+	//copied from source as opened, so crc taken on open holds for them
+	if (!block.dirty && block.map && !compress) {
 
-static uint16_t crc16_calc(uint16_t crc, const QByteArray & data)
-{
-	for (int32_t i = 0; i < data.size(); i++) {
+		qint64 offset = block.map->locate(block.offset);
+		ok = offset >= 0 && vbf_copy_range(block.map.data(), offset, block.len, file);
+		bin.crc32 = block.payload_crc32;
+	}
+	else {
 
-		crc ^= data[i] << 8;
-		for (uint8_t j = 0; j < 8; j++) {
+		//not in cache, load copy and leave vbf as is
+		block_t copy = block;
+		ok = vbf_load_block(vbf, copy);
 
-			if (crc & 0x8000)
-				crc = (crc << 1) ^ crc16_poly;
-			else
-				crc = crc << 1;
-		}
-		crc &= 0xffff;
+		const block_data_t & data = copy.data;
+		for (int i = 0; ok && i < data.extents.size(); i++)
+			ok = file.write(data.extents[i]) == data.extents[i].size();
+		bin.crc32 = copy.crc_valid ? copy.data_crc32 : vbf_crc32(data);
 	}
 
-    return crc;
-}
-
-static uint16_t crc16(const QByteArray & data)
-{
-	uint16_t crc = crc16_init();
+	file.close();
+	if (!ok)
+		return false;
 
-	crc = crc16_calc(crc, data);
+	QFileInfo info(fileName);
+	bin.size = info.size();
+	bin.mtime = info.lastModified().toMSecsSinceEpoch();
+	bin.valid = true;
 
-	return crc;
+	return true;
 }
 
-#if QT_VERSION < 0x050700
-template <typename T> inline T qFromUnaligned(const void *src)
+bool vbf_export_block(int idx, const QString & fileName, const vbf_t & vbf)
 {
-    T dest;
-    const size_t size = sizeof(T);
-    memcpy(&dest, src, size);
-    return dest;
-}
+	bin_stamp_t bin;
 
+	return vbf_export_bin(idx, fileName, vbf, bin);
+}
 
-template <class T> inline T qFromBigEndian(const void *src)
+//runs on worker thread
+static bin_stamp_t vbf_export_job(const vbf_t * vbf, int32_t idx, const QString & fileName)
 {
-    return qFromBigEndian(qFromUnaligned<T>(src));
+	bin_stamp_t bin;
+	if (!vbf_export_bin(idx, fileName, *vbf, bin))
+		qWarning() << "Can't export block to file " << fileName;
+
+	return bin;
 }
-#endif
 
-bool vbf_open(const QString & fileName, vbf_t & vbf)
+bool vbf_export(const vbf_t & vbf, QVector <bin_stamp_t> & bins, vbf_progress_t * progress)
 {
-	qInfo() << "Opening file " << fileName << " ... ";
+	int32_t nums = vbf.blocks.size();
+	bins.fill(bin_stamp_t(), nums);
 
-	QFile infile(fileName);
-	if (!infile.open(QIODevice::ReadOnly)) {
-		qWarning() << "Can't open file " << fileName;
-		return false;
-	}
-	qDebug() << "file size:" << infile.size();
+	//job holds whole decoded block, size of compressed one not in memory is bounded by variant
+	bool compress = vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10;
+	QScopedPointer <lzss_decoder_t> decoder(lzss_decoder_t::create(vbf.header.lzss_variant));
+	QVector <qint64> sizes(nums);
+	for (int32_t i = 0; i < nums; i++) {
 
-	QByteArray h = infile.read(sizeof("vbf_version = 99.99;"));
-	int offset = h.indexOf("vbf_version");
-	if (offset == -1) {
-		qWarning() << "can't find header 'vbf_version' in file";
-		infile.close();
-		return false;
+		const block_t & block = vbf.blocks[i];
+		if (block.loaded)
+			sizes[i] = block.data.size();
+		else if (compress)
+			sizes[i] = decoder->size_limit(block.len);
+		else
+			sizes[i] = block.len;
 	}
 
-	infile.seek(0);
-	h = infile.read(HEADER_LIMIT_SIZE);
+	QVector <QFuture <bin_stamp_t> > jobs(nums);
+	int32_t next = 0;
+	qint64 inflight = 0;
+	bool ok = true;
 
-	//looking for such template: header { }
-	offset = h.indexOf("header {");
-	if (offset == -1) {
-		qWarning() << "can't find begin of header";
-		infile.close();
-		return false;
-	}
-	offset += sizeof"header {";
-	size_t left_braces = 1;
-	size_t right_braces = 0;
-	while (offset < h.size()) {
-		if (h[offset] == '}')
-			right_braces++;
-		if (h[offset] == '{')
-			left_braces++;
-		if (left_braces == right_braces)
-			break;
-		offset++;
-	}
-	//qDebug().nospace() << "offset: 0x" << hex << offset << " left_braces:" << left_braces << " right_braces:" << right_braces;
+	for (int32_t i = 0; i < nums; i++) {
 
-	if (left_braces != right_braces) {
-		qWarning() << "can't find end of header";
-		infile.close();
-		return false;
-	}
+		if (ok && !vbf_progress(progress, i, i, nums)) {
 
-	header_t header;
-	header.file_checksum_offset = h.indexOf("0x", offset + 13);
-	offset = h.indexOf("}", offset);
+			qWarning() << "Export is cancelled";
+			ok = false;
+		}
 
-	offset = h.indexOf("}", offset);
-	if (offset != -1)
-		offset += 1;
+		//keep pool busy while blocks of running jobs fit into limit
+		while (ok && next < nums && (next == i || inflight + sizes[next] <= JOB_INFLIGHT_SIZE)) {
 
-	header.data = h.left(offset);
-	qDebug() << "header:" << header.data;
+			QString filename = vbf.filename + "." + QString::number(next) + ".bin";
+			jobs[next] = QtConcurrent::run(vbf_export_job, &vbf, next, filename);
+			inflight += sizes[next];
+			next++;
+		}
 
-	//parsing header
-	QBuffer qbuf(&header.data);
-	qbuf.open(QBuffer::ReadOnly);
+		//jobs refer to vbf, so all started are waited for
+		if (i >= next)
+			break;
 
-	QString line;
-	while (!qbuf.atEnd()) {
+		bins[i] = jobs[i].result();
+		jobs[i] = QFuture <bin_stamp_t>();
+		inflight -= sizes[i];
+	}
 
-		QString l = qbuf.readLine();
-		//qDebug() << l;
+	if (!ok)
+		return false;
 
-		if ((-1 != l.indexOf("//")) || (-1 != l.indexOf("header"))) {
+	vbf_progress(progress, nums, nums, nums);
 
-			line.clear();
-			continue;
-		}
+	return true;
+}
 
-		line += l;
+//bin file read by import job, data is empty while block is unchanged
+struct block_import_t
+{
+	block_data_t data;
+	bin_stamp_t bin;
+	bool changed;
+};
 
-		//multiline
-		if (-1 == line.indexOf(";"))
-			continue;
+//runs on worker thread, file is read only when its stamp does not match
+static block_import_t vbf_import_job(const block_t * block, bool compress, const QString & fileName)
+{
+	block_import_t result;
+	result.changed = false;
 
-		line = line.left(line.indexOf(";"));
-		line.replace("=", " = ");
+	QFileInfo info(fileName);
+	if (!info.exists())
+		return result;
 
-		QStringList list = line.split(QRegExp("[\r\n\t\",{} ]+"), QString::SkipEmptyParts);
+	qint64 mtime = info.lastModified().toMSecsSinceEpoch();
+	if (block->bin.valid && block->bin.size == info.size() && block->bin.mtime == mtime)
+		return result;
 
-		qDebug() << line;
-		line.clear();
-		qDebug() << list;
+	block_data_t data;
+	if (!vbf_read_file(fileName, data))
+		return result;
 
-		//qDebug() << line << list.size();
-		if (list.size() < 3)
-			continue;
+	result.bin.size = data.size();
+	result.bin.mtime = mtime;
+	result.bin.crc32 = vbf_crc32(data);
+	result.bin.valid = true;
 
-		if (list[1] != QString('='))
-			continue;
+	//crc32 of block data if known without loading it
+	bin_stamp_t expect = block->bin;
+	if (!expect.valid && block->loaded && block->crc_valid) {
 
-		if (list[0] == "vbf_version")
-			header.version = list[2];
+		expect.size = block->data.size();
+		expect.crc32 = block->data_crc32;
+		expect.valid = true;
+	}
+	else if (!expect.valid && !compress && !block->dirty && block->map) {
 
-		if (list[0] == "sw_part_number")
-			header.sw_part_number = list[2];
+		expect.size = block->len;
+		expect.crc32 = block->payload_crc32;
+		expect.valid = true;
+	}
 
-		if (list[0] == "sw_part_type")
-			header.sw_part_type = list[2];
+	if (expect.valid && expect.size == result.bin.size && expect.crc32 == result.bin.crc32)
+		return result;
 
-		if (list[0] == "can_frame_format")
-			header.can_frame_format = list[2];
+	result.data = data;
+	result.changed = true;
 
-		//vbf_version 2.2 and above
-		if (list[0] == "frame_format") {
+	return result;
+}
 
-			header.can_frame_format = list[2];
-			header.frame_format = true;
-		}
+bool vbf_import(vbf_t & vbf, vbf_progress_t * progress)
+{
+	int32_t nums = vbf.blocks.size();
+	bool compress = vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10;
 
-		if (list[0] == "network")
-			header.network = list[2];
+	//no detach of blocks while jobs refer to them
+	vbf.blocks.detach();
 
-		bool ok;
-		if (list[0] == "erase") {
+	QVector <QFuture <block_import_t> > jobs(nums);
+	QVector <qint64> sizes(nums);
+	int32_t next = 0;
+	qint64 inflight = 0;
+	int32_t changed = 0;
+	bool ok = true;
 
-			list.removeAt(0);
-			list.removeAt(0);
-			//qDebug() << list;
+	for (int32_t i = 0; i < nums; i++) {
 
-			for (int i = 0; i < list.size()/2; i++) {
+		if (ok && !vbf_progress(progress, i, i, nums)) {
 
-				erase_t erase;
-				erase.addr = list[2 * i].toLongLong(&ok, 16);
-				erase.size = list[2 * i + 1].toLongLong(&ok, 16);
-				header.erases.push_back(erase);
-			}
+			qWarning() << "Import is cancelled";
+			ok = false;
 		}
 
-		if (list[0] == "ecu_address")
-			header.ecu_address = list[2].toLongLong(&ok, 16);
-
-		if (list[0] == "call")
-			header.call = list[2].toLongLong(&ok, 16);
+		//keep pool busy while files of running jobs fit into limit, job holds
+		//whole bin file, which is decoded data, never stored block
+		while (ok && next < nums) {
 
-		if (list[0] == "file_checksum")
-			header.file_checksum = list[2].toLongLong(&ok, 16);
+			QString filename = vbf.filename + "." + QString::number(next) + ".bin";
+			sizes[next] = QFileInfo(filename).size();
+			if (next != i && inflight + sizes[next] > JOB_INFLIGHT_SIZE)
+				break;
 
-		if (list[0] == "data_format_identifier") {
-
-			header.data_format_identifier_exist = true;
-			header.data_format_identifier = list[2].toLongLong(&ok, 16);
+			jobs[next] = QtConcurrent::run(vbf_import_job, (const block_t *)&vbf.blocks[next], compress, filename);
+			inflight += sizes[next];
+			next++;
 		}
-	}
-	qbuf.close();
 
-	vbf.filename = fileName;
-	vbf.header = header;
-	vbf.size = 0;
+		//jobs refer to blocks, so all started are waited for
+		if (i >= next)
+			break;
 
-	//read all blocks
-	uint32_t crc32 = crc32_init();
-	infile.seek(offset);
-	while (1) {
+		block_import_t result = jobs[i].result();
+		jobs[i] = QFuture <block_import_t>();
+		inflight -= sizes[i];
 
-		block_t block;
+		block_t & block = vbf.blocks[i];
+		if (result.bin.valid)
+			block.bin = result.bin;
+		if (!result.changed)
+			continue;
 
-		char _addr[4];
-		if (4 != infile.read(_addr, 4))
-			break;
-		crc32 = crc32_calc(crc32, QByteArray(_addr, 4));
-		block.addr = qFromBigEndian<quint32>(_addr);
+		block.data = result.data;
+		block.len = block.data.size();
+		block.crc_valid = false;
+		block.dirty = true;
+		block.loaded = true;
+		block.map.clear();
+		changed++;
+	}
 
-		char _len[4];
-		if (4 != infile.read(_len, 4))
-			break;
-		crc32 = crc32_calc(crc32, QByteArray(_len, 4));
-		block.len = qFromBigEndian<quint32>(_len);
+	if (!ok)
+		return false;
 
-		qDebug().nospace() << "found block addr:0x" << hex << block.addr << " with size:0x" << hex << block.len << ", loading ...";
-		block.data.reserve((block.len < BLOCK_LIMIT_SIZE) ? block.len : BLOCK_LIMIT_SIZE);
+	qInfo() << changed << "of" << nums << "block(s) changed";
+	vbf_progress(progress, nums, nums, nums);
 
-		block.offset = infile.pos();
-		uint16_t crc16 = crc16_init();
-		size_t nums = block.len/CHUNK_SIZE;
-		nums = block.len % CHUNK_SIZE ? (nums + 1) : nums;
-		for (size_t i = 0; i < nums; i++) {
+	return true;
+}
 
-			size_t sz = CHUNK_SIZE;
-			if (i == (nums - 1))
-				sz = block.len % CHUNK_SIZE;
+//block as it goes to file with its checksums, raw one is copied from source file
+struct block_payload_t
+{
+	block_data_t data;
+	qint64 size;
+	uint16_t crc;
+	uint32_t data_crc32;
+	bool raw;
+	bool ok;
+};
+
+//runs on worker thread
+static block_payload_t vbf_pack_block(const block_t * block, bool compress, e_lzss_variant variant, e_lzss_level level)
+{
+	block_payload_t payload;
+	payload.raw = false;
+	payload.ok = true;
 
-			QByteArray chunk = infile.read(sz);
-			QCoreApplication::processEvents();
+	//untouched block goes as it is in source file, crcs are known
+	if (!block->dirty && block->map) {
 
-			crc16 = crc16_calc(crc16, chunk);
-			crc32 = crc32_calc(crc32, chunk);
-			if (block.data.size() < BLOCK_LIMIT_SIZE)
-				block.data += chunk;
-		}
+		payload.size = block->len;
+		payload.crc = block->payload_crc;
+		payload.data_crc32 = block->payload_crc32;
+		payload.raw = true;
 
-		if (block.len > BLOCK_LIMIT_SIZE)
-			qWarning() << "Only first 1GB will be loaded";
+		return payload;
+	}
 
-		if (vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10) {
+	if (!block->loaded) {
 
-			QByteArray udata = decode(block.data);
-			block.data = udata;
-			qDebug() << "uncompress block data: " << block.len << " to "<< udata.size();
-			crc16 = crc16_init();
-			crc16 = crc16_calc(crc16, block.data);
-		}
+		payload.ok = false;
+		return payload;
+	}
 
-		char _crc[2];
-		if (2 != infile.read(_crc, 2))
-			break;
-		crc32 = crc32_calc(crc32, QByteArray(_crc, 2));
-		uint16_t _crc16 = qFromBigEndian<quint16>(_crc);
+	if (!compress) {
 
-		qDebug().nospace() << "block addr: 0x" << hex << block.addr << " len: 0x" << block.len << " data: 0x" << block.data.size() << " _crc16: 0x" << _crc16 << " crc16: 0x" << crc16;
-		if (_crc16 == crc16) {
+		payload.data = block->data;
+		if (block->crc_valid) {
 
-			vbf.blocks.push_back(block);
-			vbf.size += block.data.size();
+			payload.crc = block->crc;
+			payload.data_crc32 = block->data_crc32;
 		}
 		else {
 
-			qWarning() << "mismatch crc16:" << hex << crc16 << "block crc:" << hex << _crc16;
+			payload.crc = vbf_crc16(payload.data);
+			payload.data_crc32 = vbf_crc32(payload.data);
 		}
+		payload.size = payload.data.size();
+
+		return payload;
 	}
 
-	infile.close();
+	//encode by chunks, checksums are calculated on produced output
+	QScopedPointer <lzss_encoder_t> encoder(lzss_encoder_t::create(variant, level));
+	uint16_t crc = crc16_init();
+	uint32_t crc32 = crc32_init();
+
+	//output of each extent goes through one reused buffer
+	QByteArray cdata;
+	cdata.reserve(CHUNK_SIZE * 2);
 
-	crc32 = crc32_finit(crc32);
+	for (int i = 0; i <= block->data.extents.size(); i++) {
 
-	if (crc32 != header.file_checksum) {
+		cdata.resize(0);
+		if (i < block->data.extents.size())
+			encoder->push(block->data.extents[i], cdata);
+		else
+			encoder->finish(cdata);
 
-		qWarning() << "mismatch crc32:" << hex << crc32 << "header crc:" << hex << header.file_checksum;
-		return false;
+		crc = crc16_calc(crc, cdata);
+		crc32 = crc32_calc(crc32, cdata);
+		payload.data.append(cdata.constData(), cdata.size());
 	}
-	qInfo() << "crc32 is OK";
 
-	qInfo() << "vbf with " << vbf.blocks.size() << " block(s) successfully loaded";
+	payload.crc = crc;
+	payload.data_crc32 = crc32_finit(crc32);
+	payload.size = payload.data.size();
 
-	return true;
+	return payload;
 }
 
-bool vbf_add(const QString & fileName, vbf_t & vbf)
+//small pieces are gathered in buf and go to file by chunks
+static bool vbf_write(QFileDevice & file, QByteArray & buf, const char * data, qint64 len)
 {
-	QFile file(fileName);
-	if (!file.open(QIODevice::ReadOnly))
-		return false;
+	if (buf.size() + len < CHUNK_SIZE) {
 
-	block_t block;
-	block.addr = 0;
-	block.data = file.readAll();
-	block.len = block.data.size();
+		buf.append(data, len);
+		return true;
+	}
 
-	file.close();
+	if (!buf.isEmpty()) {
 
-	vbf.blocks.push_back(block);
+		if (file.write(buf) != buf.size())
+			return false;
+		buf.resize(0);
+	}
+
+	if (len >= CHUNK_SIZE)
+		return file.write(data, len) == len;
+
+	buf.append(data, len);
 
 	return true;
 }
 
-bool vbf_insert(int idx, const QString & fileName, vbf_t & vbf)
+static bool vbf_flush(QFileDevice & file, QByteArray & buf)
 {
-	if (idx > vbf.blocks.size())
-		return false;
+	bool ok = buf.isEmpty() || (file.write(buf) == buf.size());
+	buf.resize(0);
 
-	QFile file(fileName);
-	if (!file.open(QIODevice::ReadOnly))
+	return ok;
+}
+
+//block bytes as stored in source file, they must still match crc taken on open
+static bool vbf_copy_raw(const block_t & block, QFileDevice & file, QByteArray & buf, vbf_pool_t & pool)
+{
+	vbf_map_t * map = block.map.data();
+	qint64 offset = map ? map->locate(block.offset) : -1;
+	if (offset < 0 || offset + block.len > map->size)
 		return false;
 
-	block_t block;
-	block.addr = 0;
-	block.data = file.readAll();
-	block.len = block.data.size();
+	char * scratch = map->data ? 0 : pool.take();
+	bool ok = true;
 
-	file.close();
+	uint32_t crc = crc32_init();
+	for (qint64 done = 0; ok && done < block.len; done += CHUNK_SIZE) {
 
-	vbf.blocks.insert(idx, block);
+		qint64 sz = qMin<qint64>(CHUNK_SIZE, block.len - done);
+		const char * chunk = map->data ? map->data + offset + done : scratch;
+		ok = map->data || map->read(offset + done, scratch, sz) == sz;
 
-	return true;
+		crc = crc32_calc(crc, chunk, sz);
+		ok = ok && vbf_write(file, buf, chunk, sz);
+	}
+
+	if (scratch)
+		pool.give(scratch);
+
+	return ok && crc32_finit(crc) == block.payload_crc32;
 }
 
-bool vbf_export_block(int idx, const QString & fileName, const vbf_t & vbf)
+#ifdef Q_OS_WIN
+//open source files of blocks which are target of save, they must be
+//closed for rename over them
+static QVector <vbf_map_t *> vbf_target_maps(const QString & fileName, const vbf_t & vbf)
 {
-	if (idx > vbf.blocks.size())
-		return false;
+	QVector <vbf_map_t *> maps;
+	QFileInfo target(fileName);
 
-	QFile file(fileName);
-	if (!file.open(QIODevice::WriteOnly))
-		return false;
+	for (int32_t i = 0; i < vbf.blocks.size(); i++) {
 
-	const block_t & block = vbf.blocks[idx];
+		vbf_map_t * map = vbf.blocks[i].map.data();
+		if (map && !maps.contains(map) && QFileInfo(map->file.fileName()) == target)
+			maps.append(map);
+	}
 
-	if (block.len > BLOCK_LIMIT_SIZE) {
+	return maps;
+}
 
-		qWarning() << "Trying export block from source file " << vbf.filename;
+//moved holds new offsets of blocks copied verbatim, by their offset in file as it was
+static void vbf_reopen_maps(const QVector <vbf_map_t *> & maps, const QHash <qint64, qint64> * moved)
+{
+	for (int i = 0; i < maps.size(); i++) {
 
-		QFile infile(vbf.filename);
-		if (!infile.open(QIODevice::ReadOnly))
-			return false;
+		vbf_map_t * map = maps[i];
+		QMutexLocker locker(&map->lock);
 
-		infile.seek(block.offset);
-		size_t nums = block.len/CHUNK_SIZE;
-		nums = block.len % CHUNK_SIZE ? (nums + 1) : nums;
-		for (size_t i = 0; i < nums; i++) {
+		if (moved) {
 
-			size_t sz = CHUNK_SIZE;
-			if (i == (nums - 1))
-				sz = block.len % CHUNK_SIZE;
-			QByteArray chunk = infile.read(sz);
-			file.write(chunk);
-		}
-	}
-	else
-		file.write(block.data);
+			//offsets are kept from original file, so blocks of history find their data too
+			QHash <qint64, qint64> located;
+			if (map->replaced) {
 
-	file.close();
+				for (QHash <qint64, qint64>::const_iterator it = map->moved.constBegin(); it != map->moved.constEnd(); ++it)
+					if (moved->contains(it.value()))
+						located.insert(it.key(), moved->value(it.value()));
+			}
+			else
+				located = *moved;
 
-	return true;
+			map->moved = located;
+			map->replaced = true;
+		}
+
+		if (!map->file.open(QIODevice::ReadOnly))
+			qWarning() << "Can't open file " << map->file.fileName();
+		map->size = map->file.size();
+	}
 }
+#endif
 
-void vbf_export(const vbf_t & vbf)
+/*
+ * File crc is found from block crcs before anything is written, so file
+ * goes in one forward pass. It is written aside and replaces target only
+ * when complete and synced to disk.
+ */
+bool vbf_save(const QString & fileName, const vbf_t & vbf, e_lzss_level level, vbf_progress_t * progress)
 {
-	for (int32_t i = 0; i < vbf.blocks.size(); i++) {
+	qInfo() << "Saving file " << fileName << " ... ";
 
-		QString filename = vbf.filename + "." + QString::number(i) + ".bin";
+	bool compress = vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10;
+	if (compress)
+		qDebug() << "lzss:" << lzss_variant_name(vbf.header.lzss_variant) << ", level" << lzss_level_name(level);
 
-		vbf_export_block(i, filename, vbf);
-	}
-}
+	int32_t nums = vbf.blocks.size();
 
-void vbf_import(vbf_t & vbf)
-{
-	for (int32_t i = 0; i < vbf.blocks.size(); i++) {
+	//compress and checksum dirty blocks on thread pool
+	QVector <QFuture <block_payload_t> > jobs;
+	for (int32_t i = 0; i < nums; i++)
+		jobs.push_back(QtConcurrent::run(vbf_pack_block, &vbf.blocks[i], compress, vbf.header.lzss_variant, level));
+
+	QVector <block_payload_t> payloads(nums);
+	uint32_t crc32 = crc32_init();
+	bool ok = true;
+
+	for (int32_t i = 0; i < nums; i++) {
 
-		QString filename = vbf.filename + "." + QString::number(i) + ".bin";
+		const block_t & block = vbf.blocks[i];
+
+		if (ok && !vbf_progress(progress, i, i, nums * 2)) {
+
+			qWarning() << "Save is cancelled";
+			ok = false;
+		}
 
-		QFile file(filename);
-		if (!file.open(QIODevice::ReadOnly))
+		//jobs refer to blocks, so all are waited for
+		payloads[i] = jobs[i].result();
+		jobs[i] = QFuture <block_payload_t>();
+
+		if (ok && !payloads[i].ok) {
+
+			qWarning().nospace() << "Can't save block addr: 0x" << hex << block.addr;
+			ok = false;
+		}
+		if (!ok)
 			continue;
 
-		QByteArray data = file.readAll();
+		const block_payload_t & payload = payloads[i];
 
-		//qDebug() << "file size:" << data.size();
-		file.close();
+		if (payload.size > BLOCK_STORED_LIMIT) {
 
-		block_t & block = vbf.blocks[i];
-		block.data = data;
-		block.len = data.size();
+			qWarning().nospace() << "Block addr: 0x" << hex << block.addr << " is too large for vbf";
+			ok = false;
+			continue;
+		}
+
+		if (compress && !payload.raw)
+			qDebug() << "compress block data: " << block.data.size() << " to "<< payload.size;
+
+		uint32_t head[2] = { qToBigEndian<quint32>(block.addr), qToBigEndian<quint32>(payload.size) };
+		crc32 = crc32_calc(crc32, head, sizeof(head));
+		crc32 = crc32_finit(crc32_combine(crc32_finit(crc32), payload.data_crc32, payload.size));
+
+		uint16_t crc16 = qToBigEndian<quint16>(payload.crc);
+		crc32 = crc32_calc(crc32, &crc16, sizeof(crc16));
 	}
-}
+	crc32 = crc32_finit(crc32);
 
-void vbf_save(const QString & fileName, const vbf_t & vbf)
-{
-	qInfo() << "Saving file " << fileName << " ... ";
+	if (!ok)
+		return false;
+
+	//header with final checksum
+	QByteArray header = vbf.header.data;
+	QByteArray ba = QString("0x%1").arg(crc32, 8, 16, QChar('0')).toLatin1();
+	if (vbf.header.file_checksum_offset + ba.size() <= (uint32_t)header.size())
+		header.replace(vbf.header.file_checksum_offset, ba.size(), ba);
 
-	QFile outfile(fileName);
-	if (!outfile.open(QIODevice::WriteOnly)) {
+	//new file replaces old one on commit, so blocks may still be mapped from it
+	QSaveFile outfile(fileName);
+	if (!outfile.open(QIODevice::WriteOnly | QIODevice::Unbuffered)) {
 		qWarning() << "Can't open file " << fileName;
-		return;
+		return false;
 	}
 
-	//write header
-	outfile.write(vbf.header.data);
+	QByteArray buf;
+	buf.reserve(CHUNK_SIZE);
+	vbf_pool_t pool;
 
-	uint32_t crc32 = crc32_init();
+#ifdef Q_OS_WIN
+	//file can't be renamed over source still open, data of blocks copied
+	//verbatim is found at its new offset after source is opened again
+	QVector <vbf_map_t *> maps = vbf_target_maps(fileName, vbf);
+	QHash <qint64, qint64> moved;
+	qint64 pos = header.size();
+#endif
 
-	//write data
-	for (int32_t i = 0; i < vbf.blocks.size(); i++) {
+	ok = vbf_write(outfile, buf, header.constData(), header.size());
 
-		uint16_t crc16 = crc16_init();
+	for (int32_t i = 0; ok && i < nums; i++) {
 
 		const block_t & block = vbf.blocks[i];
+		block_payload_t & payload = payloads[i];
 
-		qDebug() << "save block with size" << block.len;
+		if (!vbf_progress(progress, i, nums + i, nums * 2)) {
 
-		uint32_t addr = qToBigEndian<quint32>(block.addr);
-		QByteArray a((const char *)&addr, sizeof(addr));
-		outfile.write(a);
-		crc32 = crc32_calc(crc32, a);
+			qWarning() << "Save is cancelled";
+			ok = false;
+			break;
+		}
 
-		if (vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10) {
+		qDebug() << "save block with size" << payload.size;
 
-			QByteArray cdata = encode(block.data);
-			qDebug() << "compress block data: " << block.data.size() << " to "<< cdata.size();
+		uint32_t head[2] = { qToBigEndian<quint32>(block.addr), qToBigEndian<quint32>(payload.size) };
+		ok = vbf_write(outfile, buf, (const char *)head, sizeof(head));
 
-			uint32_t len = qToBigEndian<quint32>(cdata.size());
-			QByteArray l((const char *)&len, sizeof(len));
-			outfile.write(l);
-			crc32 = crc32_calc(crc32, l);
+		if (ok && payload.raw) {
 
-			outfile.write(cdata);
-			crc16 = crc16_calc(crc16, cdata);
-			crc32 = crc32_calc(crc32, cdata);
+			ok = vbf_copy_raw(block, outfile, buf, pool);
+			if (!ok)
+				qWarning().nospace() << "Can't copy block addr: 0x" << hex << block.addr << " from source file";
+#ifdef Q_OS_WIN
+			if (maps.contains(block.map.data()))
+				moved.insert(block.map->locate(block.offset), pos + sizeof(head));
+#endif
 		}
 		else {
 
-			uint32_t len = qToBigEndian<quint32>(block.len);
-			QByteArray l((const char *)&len, sizeof(len));
-			outfile.write(l);
-			crc32 = crc32_calc(crc32, l);
-
-			outfile.write(block.data);
-			crc16 = crc16_calc(crc16, block.data);
-			crc32 = crc32_calc(crc32, block.data);
+			for (int j = 0; ok && j < payload.data.extents.size(); j++)
+				ok = vbf_write(outfile, buf, payload.data.extents[j].constData(), payload.data.extents[j].size());
 		}
+		payload.data.reset();
+
+		uint16_t crc16 = qToBigEndian<quint16>(payload.crc);
+		ok = ok && vbf_write(outfile, buf, (const char *)&crc16, sizeof(crc16));
+#ifdef Q_OS_WIN
+		pos += sizeof(head) + payload.size + sizeof(crc16);
+#endif
+	}
 
-		crc16 = qToBigEndian<quint16>(crc16);
-		QByteArray c((const char *)&crc16, sizeof(crc16));
-		outfile.write(c);
-		crc32 = crc32_calc(crc32, c);
+	ok = ok && vbf_flush(outfile, buf);
+
+	if (!ok) {
+		qWarning() << "Can't write file " << fileName;
+		outfile.cancelWriting();
+		return false;
 	}
-	crc32 = crc32_finit(crc32);
 
-	//rewrite updated header
-	QByteArray header = vbf.header.data;
-	//if (vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10) {
+#ifdef Q_OS_WIN
+	for (int i = 0; i < maps.size(); i++) {
 
-		QByteArray ba = QString("0x%1").arg(crc32, 8, 16, QChar('0')).toLatin1();
-		header.replace(vbf.header.file_checksum_offset, ba.size(), ba);
-	//}
-	outfile.seek(0);
-	outfile.write(header);
+		QMutexLocker locker(&maps[i]->lock);
+		maps[i]->file.close();
+	}
+#endif
+
+	//flushed, synced and renamed over target
+	ok = outfile.commit();
+
+#ifdef Q_OS_WIN
+	//old file is still there when commit failed
+	vbf_reopen_maps(maps, ok ? &moved : 0);
+#endif
+
+	if (!ok) {
+		qWarning() << "Can't write file " << fileName;
+		return false;
+	}
+	vbf_progress(progress, nums, nums, nums);
 
 	qInfo() << "vbf with " << vbf.blocks.size() << " block(s) successfully saved";
 
-	outfile.close();
+	return true;
+}
+
+void vbf_update_block_crc(block_t & block)
+{
+	if (block.crc_valid)
+		return;
+
+	block.crc = vbf_crc16(block.data);
+	block.data_crc32 = vbf_crc32(block.data);
+	block.crc_valid = true;
 }
 
-void vbf_update_header(vbf_t & vbf)
+//checksum of addr, len, data and crc16 of all blocks from cached block crcs
+void vbf_update_checksum(vbf_t & vbf)
 {
-	QByteArray data;
+	uint32_t crc = crc32_init();
 	for (int32_t i = 0; i < vbf.blocks.size(); i++) {
 
-		const block_t & block = vbf.blocks[i];
+		block_t & block = vbf.blocks[i];
 
 		uint32_t addr = qToBigEndian<quint32>(block.addr);
-		QByteArray a((const char *)&addr, sizeof(addr));
-		data += a;
+		crc = crc32_calc(crc, &addr, sizeof(addr));
 
 		uint32_t len = qToBigEndian<quint32>(block.len);
-		QByteArray l((const char *)&len, sizeof(len));
-		data += l;
+		crc = crc32_calc(crc, &len, sizeof(len));
+
+		uint16_t c;
+		if (!block.dirty) {
 
-		data += vbf.blocks[i].data;
+			crc = crc32_finit(crc32_combine(crc32_finit(crc), block.payload_crc32, block.len));
+			c = qToBigEndian<quint16>(block.payload_crc);
+		}
+		else {
 
-		uint16_t crc = crc16(block.data);
-		crc = qToBigEndian<quint16>(crc);
-		QByteArray c((const char *)&crc, sizeof(crc));
-		data += c;
+			vbf_update_block_crc(block);
+			crc = crc32_finit(crc32_combine(crc32_finit(crc), block.data_crc32, block.data.size()));
+			c = qToBigEndian<quint16>(block.crc);
+		}
+		crc = crc32_calc(crc, &c, sizeof(c));
 	}
-	uint32_t crc = crc32(data);
-	//qDebug() << "data crc32:" << hex << crc << vbf.header.file_checksum;
+	crc = crc32_finit(crc);
 	vbf.header.file_checksum = crc;
+}
 
+void vbf_update_header(vbf_t & vbf)
+{
 	QByteArray header;
 
 	QString version = vbf.header.version.isEmpty() ? "2.1" : vbf.header.version;
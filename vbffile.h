@@ -1,22 +1,122 @@
 #ifndef VBFFILE_H
 #define VBFFILE_H
 
+#include <QAtomicInt>
 #include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
 #include <QString>
 #include <QVector>
 #include <inttypes.h>
 
+#include "lzss.h"
+
 #define CHUNK_SIZE (1*1024*1024)
 #define HEADER_LIMIT_SIZE (1*1024*1024)
-#define BLOCK_LIMIT_SIZE (1*1024*1024*1024)
+//length of block as stored in file is 32 bit
+#define BLOCK_STORED_LIMIT 0xffffffffLL
+//bytes of blocks handled by running export/import jobs
+#define JOB_INFLIGHT_SIZE (256*1024*1024)
+
+//source file of blocks, mapped into memory when data is set, it stays open
+//until last block referring to it is gone, so it is never opened by name again
+struct vbf_map_t
+{
+	QFile file;
+	//seek and read of unmapped file are one step for jobs sharing it
+	QMutex lock;
+	const char * data;
+	qint64 size;
+	//file was replaced by save over it, stored bytes of blocks copied
+	//verbatim are found by their offset in original file
+	bool replaced;
+	QHash <qint64, qint64> moved;
+
+	vbf_map_t() : data(0), size(0), replaced(false) {}
+
+	//copy of range into data, clipped to size, returns bytes copied or -1
+	qint64 read(qint64 pos, char * data, qint64 n);
+	//offset of block data in file as it is now, -1 when it is gone
+	qint64 locate(qint64 offset) const;
+};
+
+//data of block as rope of extents, each but last one is CHUNK_SIZE long, so huge
+//block needs no contiguous memory. Extents are implicitly shared and may be
+//slices of source file mapping.
+struct block_data_t
+{
+	QVector <QByteArray> extents;
+	qint64 len;
+
+	block_data_t()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		extents.clear();
+		len = 0;
+	}
+
+	qint64 size() const
+	{
+		return len;
+	}
+
+	void append(const QByteArray & data);
+	void append(const char * data, qint64 n);
+	//copy of range into data, clipped to size, returns bytes copied
+	qint64 read(qint64 pos, char * data, qint64 n) const;
+	QByteArray mid(qint64 pos, qint64 n) const;
+};
+
+//bin file block was exported to or imported from, file holds data with crc32
+//while its size and mtime are the same
+struct bin_stamp_t
+{
+	qint64 size;
+	qint64 mtime;
+	uint32_t crc32;
+	bool valid;
+
+	bin_stamp_t()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		size = 0;
+		mtime = 0;
+		crc32 = 0;
+		valid = false;
+	}
+};
 
 struct block_t
 {
 	uint32_t addr;
-	uint32_t len;
-	uint32_t offset;
-	QByteArray data;
+	qint64 len;
+	qint64 offset;
+	block_data_t data;
 	uint16_t crc;
+	//crc-32 of data, valid together with crc while crc_valid is set
+	uint32_t data_crc32;
+	bool crc_valid;
+	//crcs of block as stored in source file, saved verbatim from there while block is not dirty
+	uint16_t payload_crc;
+	uint32_t payload_crc32;
+	bool dirty;
+	//data is in memory, clean block may be dropped and loaded again from source
+	bool loaded;
+	uint64_t used;
+	//source file, data may be slice of its mapping, copied on write
+	QSharedPointer <vbf_map_t> map;
+	//reset when data is edited
+	bin_stamp_t bin;
 	uint8_t percent;
 
 	block_t()
@@ -30,7 +130,17 @@ struct block_t
 		len = 0;
 		offset = 0;
 		percent = 0;
-		data.clear();
+		data.reset();
+		crc = 0;
+		data_crc32 = 0;
+		crc_valid = false;
+		payload_crc = 0;
+		payload_crc32 = 0;
+		dirty = true;
+		loaded = true;
+		used = 0;
+		map.clear();
+		bin.reset();
 	}
 };
 
@@ -56,6 +166,8 @@ struct header_t
 	uint32_t file_checksum_offset;
 	bool data_format_identifier_exist;
 	uint32_t data_format_identifier;
+	//codec parameters of compressed data
+	e_lzss_variant lzss_variant;
 
 	header_t()
 	{
@@ -74,8 +186,10 @@ struct header_t
 		call = 0x0;
 		erases.resize(0);
 		file_checksum = 0x0;
+		file_checksum_offset = 0;
 		data_format_identifier_exist = false;
 		data_format_identifier = 0;
+		lzss_variant = e_lzss_10_4_1;
 	}
 };
 
@@ -84,7 +198,7 @@ struct vbf_t
 	QString filename;
 	header_t header;
 	QVector <block_t> blocks;
-	uint32_t size;
+	qint64 size;
 	uint8_t percent;
 	uint8_t block_idx;
 
@@ -104,9 +218,23 @@ struct vbf_t
 	}
 };
 
-bool vbf_open(const QString & fileName, vbf_t & vbf);
+//shared with thread running long operation, block_idx and percent of work done
+struct vbf_progress_t
+{
+	QAtomicInt block_idx;
+	QAtomicInt percent;
+	QAtomicInt cancel;
+};
+
+//header fields from header bytes, returns size of header up to its closing brace or -1
+int vbf_parse_header(const char * data, int size, header_t & header);
+
+bool vbf_open(const QString & fileName, vbf_t & vbf, bool mapped = true, vbf_progress_t * progress = 0);
 
-void vbf_save(const QString & fileName, const vbf_t & vbf);
+bool vbf_save(const QString & fileName, const vbf_t & vbf, e_lzss_level level = e_lzss_level_default, vbf_progress_t * progress = 0);
+
+//whole file as block data
+bool vbf_read_file(const QString & fileName, block_data_t & data);
 
 bool vbf_add(const QString & fileName, vbf_t & vbf);
 
@@ -114,10 +242,25 @@ bool vbf_insert(int idx, const QString & fileName, vbf_t & vbf);
 
 bool vbf_export_block(int idx, const QString & fileName, const vbf_t & vbf);
 
-void vbf_export(const vbf_t & vbf);
+//bin files are written on thread pool, bins gets their stamps
+bool vbf_export(const vbf_t & vbf, QVector <bin_stamp_t> & bins, vbf_progress_t * progress = 0);
+
+//unchanged bin files are skipped, so blocks stay as they are
+bool vbf_import(vbf_t & vbf, vbf_progress_t * progress = 0);
+
+//load data of block from source file on demand, block is left as it is
+//when crc16 does not match
+bool vbf_load_block(const vbf_t & vbf, block_t & block, vbf_progress_t * progress = 0);
+
+//drop data of clean block to be loaded again later
+void vbf_unload_block(block_t & block);
+
+void vbf_update_block_crc(block_t & block);
 
-void vbf_import(vbf_t & vbf);
+//file checksum from cached crcs of blocks
+void vbf_update_checksum(vbf_t & vbf);
 
+//header text from header fields and file checksum
 void vbf_update_header(vbf_t & vbf);
 
 #endif
@@ -0,0 +1,161 @@
+#include <QtConcurrentRun>
+#include <utility>
+
+#include "vbfjob.h"
+
+VbfJob::VbfJob(QObject *parent) : QObject(parent), m_job(e_job_open), m_src(NULL), m_idx(-1), m_level(e_lzss_level_default), m_percent(-1)
+{
+	connect(&m_watcher, &QFutureWatcher <bool>::finished, this, &VbfJob::slt_finished);
+
+	//progress is polled, worker does not touch objects of gui thread
+	m_timer.setInterval(100);
+	connect(&m_timer, &QTimer::timeout, this, &VbfJob::slt_timer);
+}
+
+VbfJob::~VbfJob()
+{
+	cancel();
+	m_watcher.waitForFinished();
+}
+
+bool VbfJob::busy() const
+{
+	return m_watcher.isRunning();
+}
+
+bool VbfJob::start(e_job job, const QString & fileName, vbf_t && vbf)
+{
+	if (busy())
+		return false;
+
+	m_vbf = std::move(vbf);
+	m_src = &m_vbf;
+	launch(job, fileName);
+
+	return true;
+}
+
+bool VbfJob::start(e_job job, const QString & fileName, const vbf_t * vbf)
+{
+	if (busy())
+		return false;
+
+	m_vbf.reset();
+	m_src = vbf;
+	launch(job, fileName);
+
+	return true;
+}
+
+bool VbfJob::start(e_job job, int idx, const vbf_t * vbf)
+{
+	if (busy() || idx < 0 || idx >= vbf->blocks.size())
+		return false;
+
+	m_vbf.reset();
+	m_src = vbf;
+	m_idx = idx;
+	launch(job, vbf->filename);
+
+	return true;
+}
+
+void VbfJob::launch(e_job job, const QString & fileName)
+{
+	m_job = job;
+	m_fileName = fileName;
+	m_bins.clear();
+	m_block.reset();
+	m_progress.block_idx.store(0);
+	m_progress.percent.store(0);
+	m_progress.cancel.store(0);
+	m_percent = -1;
+
+	m_watcher.setFuture(QtConcurrent::run(this, &VbfJob::run));
+	m_timer.start();
+}
+
+void VbfJob::cancel()
+{
+	m_progress.cancel.store(1);
+}
+
+void VbfJob::set_level(e_lzss_level level)
+{
+	m_level = level;
+}
+
+VbfJob::e_job VbfJob::job() const
+{
+	return m_job;
+}
+
+const QString & VbfJob::file_name() const
+{
+	return m_fileName;
+}
+
+vbf_t VbfJob::take()
+{
+	vbf_t r = std::move(m_vbf);
+	m_vbf.reset();
+	m_src = NULL;
+
+	return r;
+}
+
+int VbfJob::block_idx() const
+{
+	return m_idx;
+}
+
+const block_t & VbfJob::block() const
+{
+	return m_block;
+}
+
+const QVector <bin_stamp_t> & VbfJob::bins() const
+{
+	return m_bins;
+}
+
+//runs on worker thread
+bool VbfJob::run()
+{
+	switch (m_job) {
+
+		case e_job_open:
+			m_vbf.reset();
+			return vbf_open(m_fileName, m_vbf, true, &m_progress);
+		case e_job_save:
+			return vbf_save(m_fileName, *m_src, m_level, &m_progress);
+		case e_job_import:
+			return vbf_import(m_vbf, &m_progress);
+		case e_job_export:
+			return vbf_export(*m_src, m_bins, &m_progress);
+		case e_job_load:
+			m_progress.block_idx.store(m_idx);
+			m_block = m_src->blocks[m_idx];
+			return vbf_load_block(*m_src, m_block, &m_progress);
+		default:
+			return false;
+	}
+}
+
+void VbfJob::slt_timer()
+{
+	int percent = m_progress.percent.load();
+	if (percent == m_percent)
+		return;
+
+	m_percent = percent;
+	emit sig_progress(percent, m_progress.block_idx.load());
+}
+
+void VbfJob::slt_finished()
+{
+	m_timer.stop();
+	slt_timer();
+
+	emit sig_finished(m_watcher.result());
+}
@@ -0,0 +1,77 @@
+#ifndef VBFJOB_H
+#define VBFJOB_H
+
+#include <QObject>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include "vbffile.h"
+
+//runs open, save, import or export of vbf on thread pool, one at a time
+class VbfJob : public QObject
+{
+	Q_OBJECT
+
+	public:
+		enum e_job
+		{
+			e_job_open = 0,
+			e_job_save,
+			e_job_import,
+			e_job_export,
+			e_job_load,
+			e_job_nums
+		};
+
+		VbfJob(QObject *parent = 0);
+		~VbfJob();
+
+		bool busy() const;
+		//open and import own vbf, it is moved in and taken back after sig_finished
+		bool start(e_job job, const QString & fileName, vbf_t && vbf = vbf_t());
+		//save and export only read vbf, it must stay unchanged while job is running
+		bool start(e_job job, const QString & fileName, const vbf_t * vbf);
+		//load reads data of block idx into own copy of it
+		bool start(e_job job, int idx, const vbf_t * vbf);
+		void cancel();
+		//encoder effort of next save
+		void set_level(e_lzss_level level);
+
+		e_job job() const;
+		const QString & file_name() const;
+		//opened or imported vbf, valid after sig_finished
+		vbf_t take();
+		//loaded block and its index, valid after sig_finished
+		int block_idx() const;
+		const block_t & block() const;
+		//stamps of exported bin files
+		const QVector <bin_stamp_t> & bins() const;
+
+	signals:
+		void sig_progress(int percent, int block_idx);
+		void sig_finished(bool ok);
+
+	private slots:
+		void slt_timer();
+		void slt_finished();
+
+	private:
+		void launch(e_job job, const QString & fileName);
+		bool run();
+
+		e_job m_job;
+		QString m_fileName;
+		vbf_t m_vbf;
+		const vbf_t * m_src;
+		int m_idx;
+		block_t m_block;
+		e_lzss_level m_level;
+		QVector <bin_stamp_t> m_bins;
+		vbf_progress_t m_progress;
+		QFutureWatcher <bool> m_watcher;
+		QTimer m_timer;
+		int m_percent;
+};
+
+#endif
+
@@ -1,8 +1,9 @@
 #include <QIcon>
+#include <utility>
 
 #include "vbfmodel.h"
 
-VbfModel::VbfModel(QObject *parent) : QAbstractListModel(parent)
+VbfModel::VbfModel(QObject *parent) : QAbstractListModel(parent), clock(0), cache_size(BLOCK_CACHE_SIZE)
 {
 	reset();
 }
@@ -76,8 +77,9 @@ QVariant VbfModel::data(const QModelIndex &index, int role) const
 				else {
 
 					const block_t & block = vbf.blocks[index.row() - 1/*header*/];
+					//decoded size is known once block is loaded
 					if (vbf.header.data_format_identifier_exist && vbf.header.data_format_identifier == 0x10)
-						return QString("%1(%2)").arg(block.len).arg(block.data.size());
+						return block.loaded ? QString("%1(%2)").arg(block.len).arg(block.data.size()) : QString("%1(?)").arg(block.len);
 					else
 						return QString("%1").arg(block.len);
 				}
@@ -97,11 +99,42 @@ QVariant VbfModel::data(const QModelIndex &index, int role) const
 	return QVariant();
 }
 
-void VbfModel::set(const vbf_t & _vbf)
+//cached data of clean blocks is not kept by history, it is loaded again after undo
+static void vbf_drop_cache(vbf_t & vbf)
+{
+	for (int32_t i = 0; i < vbf.blocks.size(); i++)
+		vbf_unload_block(vbf.blocks[i]);
+}
+
+//copy of image with own block vector, so blocks of current one stay in place
+static vbf_t vbf_snapshot(const vbf_t & vbf)
+{
+	vbf_t s = vbf;
+	s.blocks.detach();
+	vbf_drop_cache(s);
+
+	return s;
+}
+
+void VbfModel::set(vbf_t && _vbf, bool keep_history)
 {
 	beginResetModel();
-	vbf = _vbf;
+	vbf = std::move(_vbf);
 	endResetModel();
+
+	if (!keep_history)
+		clear_history();
+}
+
+//model is left empty
+vbf_t VbfModel::take()
+{
+	beginResetModel();
+	vbf_t r = std::move(vbf);
+	vbf.reset();
+	endResetModel();
+
+	return r;
 }
 
 const vbf_t & VbfModel::get()
@@ -111,10 +144,18 @@ const vbf_t & VbfModel::get()
 
 bool VbfModel::add(const QString & fileName)
 {
+	vbf_t s = vbf_snapshot(vbf);
+
 	beginResetModel();
 	bool r = vbf_add(fileName, vbf);
 	endResetModel();
 
+	if (r) {
+
+		push_undo(s);
+		update_checksum();
+	}
+
 	return r;
 }
 
@@ -123,10 +164,18 @@ bool VbfModel::insert(int idx, const QString & fileName)
 	if (idx > vbf.blocks.size() || idx < 1)
 		return false;
 
+	vbf_t s = vbf_snapshot(vbf);
+
 	beginResetModel();
 	bool r = vbf_insert(idx - 1/*header*/, fileName, vbf);
 	endResetModel();
 
+	if (r) {
+
+		push_undo(s);
+		update_checksum();
+	}
+
 	return r;
 }
 
@@ -135,9 +184,13 @@ void VbfModel::rm(int idx)
 	if (idx > vbf.blocks.size() || idx < 1)
 		return;
 
+	push_undo(vbf_snapshot(vbf));
+
 	beginResetModel();
 	vbf.blocks.remove(idx - 1/*header*/);
 	endResetModel();
+
+	update_checksum();
 }
 
 int VbfModel::size()
@@ -147,37 +200,236 @@ int VbfModel::size()
 
 const block_t & VbfModel::get_block(int idx)
 {
-	if (idx > vbf.blocks.size())
+	if (idx < 0 || idx >= vbf.blocks.size())
 		return empty;
 
-	return vbf.blocks[idx];
+	block_t & block = vbf.blocks[idx];
+	block.used = ++clock;
+
+	return block;
+}
+
+bool VbfModel::set_loaded(int idx, const block_t & loaded)
+{
+	if (idx < 0 || idx >= vbf.blocks.size())
+		return false;
+
+	block_t & block = vbf.blocks[idx];
+	if (block.loaded || !loaded.loaded || block.map != loaded.map || block.offset != loaded.offset)
+		return false;
+
+	block = loaded;
+	block.used = ++clock;
+
+	evict(idx);
+
+	return true;
+}
+
+void VbfModel::set_cache_size(qint64 size)
+{
+	cache_size = size;
+
+	evict(-1);
+}
+
+//drop least recently used clean blocks until loaded data fits into cache
+void VbfModel::evict(int keep)
+{
+	while (1) {
+
+		qint64 total = 0;
+		int lru = -1;
+		for (int i = 0; i < vbf.blocks.size(); i++) {
+
+			const block_t & block = vbf.blocks[i];
+			if (!block.loaded)
+				continue;
+
+			total += block.data.size();
+			if (i == keep || block.dirty || !block.map)
+				continue;
+			if (lru == -1 || block.used < vbf.blocks[lru].used)
+				lru = i;
+		}
+
+		if (total <= cache_size || lru == -1)
+			break;
+
+		vbf_unload_block(vbf.blocks[lru]);
+	}
 }
 
 void VbfModel::update_block(int idx, uint32_t addr)
 {
-	if (idx > vbf.blocks.size())
+	if (idx < 0 || idx >= vbf.blocks.size())
 		return;
 
 	block_t & block = vbf.blocks[idx];
+	if (block.addr == addr)
+		return;
 
+	push_undo(vbf_snapshot(vbf));
 	block.addr = addr;
+
+	update_checksum();
 }
 
-void VbfModel::update_block(int idx, const QByteArray & data)
+void VbfModel::update_block(int idx, const block_data_t & data)
 {
-	if (idx > vbf.blocks.size())
+	if (idx < 0 || idx >= vbf.blocks.size())
 		return;
 
-	block_t & block = vbf.blocks[idx];
+	push_undo(vbf_snapshot(vbf));
 
+	block_t & block = vbf.blocks[idx];
 	block.data = data;
 	block.len = block.data.size();
+	block.crc_valid = false;
+	block.dirty = true;
+	block.loaded = true;
+	block.map.clear();
+	block.bin.reset();
+
+	update_checksum();
+}
+
+//stamps of bin files written by export
+void VbfModel::update_bin(const QVector <bin_stamp_t> & bins)
+{
+	for (int i = 0; i < vbf.blocks.size() && i < bins.size(); i++) {
+
+		if (bins[i].valid)
+			vbf.blocks[i].bin = bins[i];
+	}
+}
+
+//fields are changed in place, erase list is made of blocks when it is enabled
+void VbfModel::update_header(const QString & sw_part_number, const QString & sw_part_type, const QString & network,
+		const QString & can_frame_format, uint32_t ecu_address, uint32_t call, bool erase)
+{
+	header_t & header = vbf.header;
+
+	bool changed = header.sw_part_number != sw_part_number || header.sw_part_type != sw_part_type ||
+		header.network != network || header.can_frame_format != can_frame_format ||
+		header.ecu_address != ecu_address || header.call != call || erase == header.erases.isEmpty();
+	//also called to refresh header text after block changes
+	if (changed)
+		push_undo(vbf_snapshot(vbf));
+
+	header.sw_part_number = sw_part_number;
+	header.sw_part_type = sw_part_type;
+	header.network = network;
+	header.can_frame_format = can_frame_format;
+	header.ecu_address = ecu_address;
+	header.call = call;
+
+	if (!erase)
+		header.erases.clear();
+
+	if (erase && !header.erases.size()) {
+
+		for (int32_t i = 0; i < vbf.blocks.size(); i++) {
+
+			const block_t & block = vbf.blocks[i];
+
+			erase_t e;
+			e.addr = block.addr;
+			e.size = block.len;
+			header.erases.push_back(e);
+		}
+	}
+
+	//checksum is kept up to date by block changes
+	vbf_update_header(vbf);
 }
 
-void VbfModel::update_header(struct header_t & header)
+/*
+ * Variant tells how stored data of file is to be decoded, clean blocks are
+ * loaded again with it. Edited ones are encoded with it on save.
+ */
+void VbfModel::update_lzss_variant(e_lzss_variant variant)
 {
-	vbf.header = header;
+	if (vbf.header.lzss_variant == variant)
+		return;
+
+	push_undo(vbf_snapshot(vbf));
+
+	beginResetModel();
+	vbf.header.lzss_variant = variant;
+	vbf_drop_cache(vbf);
+	endResetModel();
+}
 
+void VbfModel::update_checksum()
+{
+	vbf_update_checksum(vbf);
 	vbf_update_header(vbf);
 }
 
+void VbfModel::push_undo(const vbf_t & snapshot)
+{
+	undo_list.append(snapshot);
+	while (undo_list.size() > UNDO_LEVELS)
+		undo_list.removeFirst();
+	redo_list.clear();
+
+	emit sig_history();
+}
+
+void VbfModel::checkpoint()
+{
+	push_undo(vbf_snapshot(vbf));
+}
+
+void VbfModel::clear_history()
+{
+	undo_list.clear();
+	redo_list.clear();
+
+	emit sig_history();
+}
+
+bool VbfModel::can_undo() const
+{
+	return !undo_list.isEmpty();
+}
+
+bool VbfModel::can_redo() const
+{
+	return !redo_list.isEmpty();
+}
+
+//current image goes to other list, it is swapped, not copied
+bool VbfModel::undo()
+{
+	if (undo_list.isEmpty())
+		return false;
+
+	beginResetModel();
+	vbf_drop_cache(vbf);
+	redo_list.append(std::move(vbf));
+	vbf = undo_list.takeLast();
+	endResetModel();
+
+	emit sig_history();
+
+	return true;
+}
+
+bool VbfModel::redo()
+{
+	if (redo_list.isEmpty())
+		return false;
+
+	beginResetModel();
+	vbf_drop_cache(vbf);
+	undo_list.append(std::move(vbf));
+	vbf = redo_list.takeLast();
+	endResetModel();
+
+	emit sig_history();
+
+	return true;
+}
+
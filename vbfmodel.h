@@ -2,9 +2,15 @@
 #define VBFMODEL_H
 
 #include <QAbstractListModel>
+#include <QList>
 
 #include "vbffile.h"
 
+//memory for loaded blocks, least recently used clean ones are dropped over it
+#define BLOCK_CACHE_SIZE (256*1024*1024)
+//edits kept for undo
+#define UNDO_LEVELS 256
+
 class VbfModel : public QAbstractListModel
 { 
 	Q_OBJECT
@@ -12,9 +18,18 @@ class VbfModel : public QAbstractListModel
 	private:
 		block_t empty;
 		vbf_t vbf;
+		uint64_t clock;
+		qint64 cache_size;
+		//snapshots of image, they share payloads of blocks with current one
+		QList <vbf_t> undo_list;
+		QList <vbf_t> redo_list;
+
+		void evict(int keep);
+		void push_undo(const vbf_t & snapshot);
 
 	signals:
 		void sig_resize();
+		void sig_history();
 
 	public:
 		VbfModel(QObject *parent = 0);
@@ -35,15 +50,33 @@ class VbfModel : public QAbstractListModel
 	public:
 		void reset();
 		int size();
-		void set(const vbf_t & vbf);
+		//image is moved in and out, never copied, history is dropped unless kept
+		void set(vbf_t && vbf, bool keep_history = false);
+		vbf_t take();
 		const vbf_t & get();
 		bool add(const QString & fileName);
 		bool insert(int idx, const QString & fileName);
 		void rm(int idx);
+		//data of block may not be loaded yet, see set_loaded()
 		const block_t & get_block(int idx);
+		//block loaded out of model by job, taken only while it still matches
+		bool set_loaded(int idx, const block_t & block);
+		void set_cache_size(qint64 size);
 		void update_block(int idx, uint32_t addr);
-		void update_block(int idx, const QByteArray & data);
-		void update_header(struct header_t & header);
+		void update_block(int idx, const block_data_t & data);
+		void update_header(const QString & sw_part_number, const QString & sw_part_type, const QString & network,
+				const QString & can_frame_format, uint32_t ecu_address, uint32_t call, bool erase);
+		void update_checksum();
+		void update_lzss_variant(e_lzss_variant variant);
+		void update_bin(const QVector <bin_stamp_t> & bins);
+
+		bool can_undo() const;
+		bool can_redo() const;
+		bool undo();
+		bool redo();
+		//current image becomes undo step, for changes made out of model
+		void checkpoint();
+		void clear_history();
 };
 
 #endif
@@ -4,7 +4,12 @@
 #include <QPainter>
 #include <QSize>
 #include <QPaintEvent>
+#include <QKeyEvent>
+#include <QWheelEvent>
 #include <QApplication>
+#include <QInputDialog>
+#include <QLineEdit>
+#include <QGlyphRun>
 
 #include <QDebug>
 
@@ -14,12 +19,170 @@ const int HEXCHARS_IN_LINE = 47;
 const int GAP_ADR_HEX = 10;
 const int GAP_HEX_ASCII = 16;
 const int BYTES_PER_LINE = 16;
+//address, two hex digits and ascii char of each byte
+const int GLYPHS_IN_LINE = 10 + 3 * BYTES_PER_LINE;
+//lines beyond it are mapped onto scrollbar proportionally
+const int SCROLL_RANGE = 1 << 30;
 
 wdg_hexview::wdg_hexview(QWidget *parent) : QAbstractScrollArea(parent)
 {
 	m_data = NULL;
+	m_topLine = 0;
+	m_wheelDelta = 0;
+	m_updatingBar = false;
 	setFont(QFont("Courier", 10));
 
+	updateGlyphs();
+
+	setFocusPolicy(Qt::StrongFocus);
+}
+
+wdg_hexview::~wdg_hexview()
+{
+}
+
+void wdg_hexview::setData(const block_data_t * data)
+{
+	m_data = data;
+	m_topLine = 0;
+	m_wheelDelta = 0;
+	updateScrollBar();
+	viewport()->update();
+}
+
+qint64 wdg_hexview::lineCount() const
+{
+	qint64 size = m_data ? m_data->size() : 0;
+
+	return (size + BYTES_PER_LINE - 1) / BYTES_PER_LINE;
+}
+
+qint64 wdg_hexview::visibleLines() const
+{
+	return qMax<qint64>(1, viewport()->height() / m_charHeight);
+}
+
+qint64 wdg_hexview::maxTopLine() const
+{
+	return qMax<qint64>(0, lineCount() - visibleLines());
+}
+
+//scrollbar range in lines while they fit, else scaled onto SCROLL_RANGE,
+//signals stay on, so scroll area still shows or hides bar on rangeChanged
+void wdg_hexview::updateScrollBar()
+{
+	QScrollBar * bar = verticalScrollBar();
+	m_updatingBar = true;
+
+	qint64 top = maxTopLine();
+	if (top <= SCROLL_RANGE) {
+
+		bar->setRange(0, (int)top);
+		bar->setPageStep((int)visibleLines());
+		bar->setSingleStep(1);
+		bar->setValue((int)m_topLine);
+	}
+	else {
+
+		bar->setRange(0, SCROLL_RANGE);
+		bar->setPageStep((int)qMax<qint64>(1, visibleLines() * SCROLL_RANGE / top));
+		bar->setSingleStep(1);
+		bar->setValue((int)((double)m_topLine / top * SCROLL_RANGE));
+	}
+
+	m_updatingBar = false;
+}
+
+void wdg_hexview::setTopLine(qint64 line)
+{
+	line = qBound<qint64>(0, line, maxTopLine());
+	if (line == m_topLine)
+		return;
+
+	m_topLine = line;
+	updateScrollBar();
+	viewport()->update();
+}
+
+void wdg_hexview::scrollToAddress(qint64 addr)
+{
+	setTopLine(addr / BYTES_PER_LINE);
+}
+
+//scrollbar moved by user, not by updateScrollBar()
+void wdg_hexview::scrollContentsBy(int, int)
+{
+	if (m_updatingBar)
+		return;
+
+	qint64 top = maxTopLine();
+	int value = verticalScrollBar()->value();
+
+	if (top <= SCROLL_RANGE)
+		m_topLine = value;
+	else if (value >= SCROLL_RANGE)
+		m_topLine = top;
+	else
+		m_topLine = qMin<qint64>(top, (qint64)((double)value / SCROLL_RANGE * top));
+
+	viewport()->update();
+}
+
+void wdg_hexview::resizeEvent(QResizeEvent *event)
+{
+	QAbstractScrollArea::resizeEvent(event);
+
+	m_topLine = qMin(m_topLine, maxTopLine());
+	updateScrollBar();
+}
+
+//stepped in lines, scaled scrollbar would skip many of them
+void wdg_hexview::wheelEvent(QWheelEvent *event)
+{
+	m_wheelDelta += event->angleDelta().y();
+
+	int steps = m_wheelDelta / 120;
+	m_wheelDelta %= 120;
+
+	setTopLine(m_topLine - (qint64)steps * QApplication::wheelScrollLines());
+	event->accept();
+}
+
+void wdg_hexview::keyPressEvent(QKeyEvent *event)
+{
+	if (event->matches(QKeySequence::MoveToPreviousLine))
+		setTopLine(m_topLine - 1);
+	else if (event->matches(QKeySequence::MoveToNextLine))
+		setTopLine(m_topLine + 1);
+	else if (event->matches(QKeySequence::MoveToPreviousPage))
+		setTopLine(m_topLine - visibleLines());
+	else if (event->matches(QKeySequence::MoveToNextPage))
+		setTopLine(m_topLine + visibleLines());
+	else if (event->matches(QKeySequence::MoveToStartOfDocument))
+		setTopLine(0);
+	else if (event->matches(QKeySequence::MoveToEndOfDocument))
+		setTopLine(maxTopLine());
+	else if (event->key() == Qt::Key_G && (event->modifiers() & Qt::ControlModifier)) {
+
+		bool ok = false;
+		QString txt = QInputDialog::getText(this, "Go to address", "Address (hex):", QLineEdit::Normal,
+				QString::number(m_topLine * BYTES_PER_LINE, 16), &ok);
+		if (!ok)
+			return;
+
+		qint64 addr = txt.trimmed().remove("0x").toLongLong(&ok, 16);
+		if (ok && m_data && addr >= 0 && addr < m_data->size())
+			scrollToAddress(addr);
+		else
+			qWarning() << "hexview: bad address" << txt;
+	}
+	else
+		QAbstractScrollArea::keyPressEvent(event);
+}
+
+//metrics and glyph indexes of current font
+void wdg_hexview::updateGlyphs()
+{
 	//m_charWidth = fontMetrics().horizontalAdvance(QLatin1Char('9'));
 	m_charWidth = fontMetrics().width(QLatin1Char('9'));
 	m_charHeight = fontMetrics().height();
@@ -30,51 +193,41 @@ wdg_hexview::wdg_hexview(QWidget *parent) : QAbstractScrollArea(parent)
 
 	setMinimumWidth(m_posAscii + (BYTES_PER_LINE * m_charWidth));
 
-	setFocusPolicy(Qt::StrongFocus);
-}
+	m_rawFont = QRawFont::fromFont(font());
 
-wdg_hexview::~wdg_hexview()
-{
-}
+	QVector <quint32> hex = m_rawFont.glyphIndexesForString("0123456789abcdef");
+	for (int i = 0; i < 16; i++)
+		m_hexGlyph[i] = i < hex.size() ? hex[i] : 0;
 
-void wdg_hexview::setData(const QByteArray * data)
-{
-	verticalScrollBar()->setValue(0);
-	m_data = data;
-	viewport()->update();
+	QString chars;
+	for (int i = 0; i < 256; i++)
+		chars += ((i < 0x20) || (i > 0x7e)) ? QChar('.') : QChar(i);
+
+	QVector <quint32> ascii = m_rawFont.glyphIndexesForString(chars);
+	for (int i = 0; i < 256; i++)
+		m_asciiGlyph[i] = i < ascii.size() ? ascii[i] : 0;
 }
 
-QSize wdg_hexview::fullSize() const
+void wdg_hexview::changeEvent(QEvent *event)
 {
-	std::size_t size = m_data ? m_data->size() : 0;
-	std::size_t width = m_posAscii + (BYTES_PER_LINE * m_charWidth);
-	std::size_t height = size / BYTES_PER_LINE;
-	if (size % BYTES_PER_LINE)
-		height++;
+	QAbstractScrollArea::changeEvent(event);
 
-	height *= m_charHeight;
+	if (event->type() == QEvent::FontChange) {
 
-	return QSize(width, height);
+		updateGlyphs();
+		m_topLine = qMin(m_topLine, maxTopLine());
+		updateScrollBar();
+		viewport()->update();
+	}
 }
 
 void wdg_hexview::paintEvent(QPaintEvent *event)
 {
 	QPainter painter(viewport());
-	std::size_t size = m_data ? m_data->size() : 0;
-	QSize areaSize = viewport()->size();
-	QSize widgetSize = fullSize();
-	verticalScrollBar()->setPageStep(areaSize.height() / m_charHeight);
-	verticalScrollBar()->setRange(0, (widgetSize.height() - areaSize.height()) / m_charHeight + 1);
-
-	int firstLineIdx = verticalScrollBar() -> value();
 
-	int lastLineIdx = firstLineIdx + areaSize.height() / m_charHeight;
-	if (lastLineIdx > size / BYTES_PER_LINE)
-	{
-		lastLineIdx = size / BYTES_PER_LINE;
-		if (size % BYTES_PER_LINE)
-			lastLineIdx++;
-	}
+	//only visible window is fetched, whatever size of block
+	qint64 firstLineIdx = m_topLine;
+	qint64 lastLineIdx = qMin(lineCount(), firstLineIdx + visibleLines());
 
 	painter.fillRect(event->rect(), this->palette().color(QPalette::Base));
 
@@ -88,44 +241,48 @@ void wdg_hexview::paintEvent(QPaintEvent *event)
 
 	painter.setPen(Qt::black);
 
-	int yPosStart = m_charHeight;
+	if (!m_data || lastLineIdx <= firstLineIdx || !m_rawFont.isValid())
+		return;
 
-	QBrush def = painter.brush();
+	//visible window only, copied into buffer kept between paints
+	m_lines.resize((int)(lastLineIdx - firstLineIdx) * BYTES_PER_LINE);
+	int len = m_data->read(firstLineIdx * BYTES_PER_LINE, m_lines.data(), m_lines.size());
+	const uchar * data = (const uchar *)m_lines.constData();
 
-	QByteArray data;
-	if (m_data)
-		data = m_data->mid(firstLineIdx * BYTES_PER_LINE, (lastLineIdx - firstLineIdx) * BYTES_PER_LINE);
+	m_glyphs.resize(0);
+	m_positions.resize(0);
+	m_glyphs.reserve((lastLineIdx - firstLineIdx) * GLYPHS_IN_LINE);
+	m_positions.reserve((lastLineIdx - firstLineIdx) * GLYPHS_IN_LINE);
 
-	for (int lineIdx = firstLineIdx, yPos = yPosStart;  lineIdx < lastLineIdx; lineIdx += 1, yPos += m_charHeight)
+	qreal yPos = m_charHeight;
+	for (qint64 lineIdx = firstLineIdx; lineIdx < lastLineIdx; lineIdx++, yPos += m_charHeight)
 	{
-		QString address = QString("%1").arg(lineIdx * 16, 10, 16, QChar('0'));
-		painter.drawText(m_posAddr, yPos, address);
-
-		for(int xPos = m_posHex, i=0; i<BYTES_PER_LINE && ((lineIdx - firstLineIdx) * BYTES_PER_LINE + i) < data.size(); i++, xPos += 3 * m_charWidth)
-		{
-			QString val = QString::number((data.at((lineIdx - firstLineIdx) * BYTES_PER_LINE + i) & 0xF0) >> 4, 16);
-			painter.drawText(xPos, yPos, val);
-
-			painter.setBackground(def);
-			painter.setBackgroundMode(Qt::OpaqueMode);
-
-			val = QString::number((data.at((lineIdx - firstLineIdx) * BYTES_PER_LINE + i) & 0xF), 16);
-			painter.drawText(xPos+m_charWidth, yPos, val);
-
-			painter.setBackground(def);
-			painter.setBackgroundMode(Qt::OpaqueMode);
+		qint64 address = lineIdx * BYTES_PER_LINE;
+		for (int i = 0; i < 10; i++) {
 
+			m_glyphs.append(m_hexGlyph[(address >> (4 * (9 - i))) & 0xf]);
+			m_positions.append(QPointF(m_posAddr + i * m_charWidth, yPos));
 		}
 
-		for (int xPosAscii = m_posAscii, i=0; ((lineIdx - firstLineIdx) * BYTES_PER_LINE + i) < data.size() && (i < BYTES_PER_LINE); i++, xPosAscii += m_charWidth)
-		{
-			char ch = data[(lineIdx - firstLineIdx) * BYTES_PER_LINE + i];
-			if ((ch < 0x20) || (ch > 0x7e))
-				ch = '.';
+		int from = (int)(lineIdx - firstLineIdx) * BYTES_PER_LINE;
+		int n = qMin(BYTES_PER_LINE, len - from);
+		for (int i = 0; i < n; i++) {
 
-			painter.drawText(xPosAscii, yPos, QString(ch));
-		}
+			uchar ch = data[from + i];
+			qreal xPos = m_posHex + i * 3 * m_charWidth;
 
+			m_glyphs.append(m_hexGlyph[ch >> 4]);
+			m_positions.append(QPointF(xPos, yPos));
+			m_glyphs.append(m_hexGlyph[ch & 0xf]);
+			m_positions.append(QPointF(xPos + m_charWidth, yPos));
+			m_glyphs.append(m_asciiGlyph[ch]);
+			m_positions.append(QPointF(m_posAscii + i * m_charWidth, yPos));
+		}
 	}
-}
 
+	QGlyphRun run;
+	run.setRawFont(m_rawFont);
+	run.setGlyphIndexes(m_glyphs);
+	run.setPositions(m_positions);
+	painter.drawGlyphRun(QPointF(0, 0), run);
+}
@@ -3,6 +3,11 @@
 
 #include <QAbstractScrollArea>
 #include <QByteArray>
+#include <QPointF>
+#include <QRawFont>
+#include <QVector>
+
+#include "vbffile.h"
 
 class wdg_hexview: public QAbstractScrollArea
 {
@@ -11,13 +16,20 @@ class wdg_hexview: public QAbstractScrollArea
 		~wdg_hexview();
 
 	public slots:
-		void setData(const QByteArray * data);
+		void setData(const block_data_t * data);
+		//line holding byte at addr becomes first visible one
+		void scrollToAddress(qint64 addr);
 
 	protected:
 		void paintEvent(QPaintEvent *event);
+		void changeEvent(QEvent *event);
+		void resizeEvent(QResizeEvent *event);
+		void scrollContentsBy(int dx, int dy);
+		void wheelEvent(QWheelEvent *event);
+		void keyPressEvent(QKeyEvent *event);
 
 	private:
-		const QByteArray * m_data;
+		const block_data_t * m_data;
 		std::size_t m_posAddr; 
 		std::size_t m_posHex;
 		std::size_t m_posAscii;
@@ -26,7 +38,28 @@ class wdg_hexview: public QAbstractScrollArea
 
 		std::size_t m_cursorPos;
 
-		QSize fullSize() const;
+		//first visible line, scrollbar only mirrors it, scaled down when
+		//lines do not fit into its int range
+		qint64 m_topLine;
+		int m_wheelDelta;
+		//scrollbar is set from m_topLine, its value changes are not user scrolls
+		bool m_updatingBar;
+
+		//glyphs of hex digits and of ascii column for each byte value
+		QRawFont m_rawFont;
+		quint32 m_hexGlyph[16];
+		quint32 m_asciiGlyph[256];
+		//reused by each paint, visible lines are drawn as one glyph run
+		QByteArray m_lines;
+		QVector <quint32> m_glyphs;
+		QVector <QPointF> m_positions;
+
+		void updateGlyphs();
+		void updateScrollBar();
+		void setTopLine(qint64 line);
+		qint64 lineCount() const;
+		qint64 visibleLines() const;
+		qint64 maxTopLine() const;
 };
 
 #endif